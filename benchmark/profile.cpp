@@ -2,7 +2,7 @@
 #include <numeric>
 
 #include "util.hpp"
-#include "types.hpp"
+#include "registry.hpp"
 #include "util_types.hpp"
 
 using namespace rdf;
@@ -13,6 +13,24 @@ struct query {
     uint64_t id;
 };
 
+// the search of find, for the sequences that choose one
+template <typename Nodes>
+std::string search_name(Nodes const&) {
+    return "-";
+}
+
+std::string search_name(uint8_t type) {
+    return type == search::interpolation ? "interpolation" : "binary";
+}
+
+std::string search_name(compact_vector const& nodes) {
+    return search_name(nodes.search_type());
+}
+
+std::string search_name(ef::ef_sequence const& nodes) {
+    return search_name(nodes.search_type());
+}
+
 template <typename Permutation>
 void queries(Permutation& permutation, char const* query_filename,
              uint32_t runs, uint64_t num_queries, uint64_t num_triplets,
@@ -36,6 +54,7 @@ void queries(Permutation& permutation, char const* query_filename,
                          whole_index_bytes
                   << "%" << std::endl;
         stats.add("nodes_bpt", std::to_string(nodes_bpt));
+        stats.add("search", search_name(permutation.second.nodes));
 
         // scan
         {
@@ -163,6 +182,7 @@ void queries(Permutation& permutation, char const* query_filename,
         std::cout << permutation.third.nodes.bytes() * 100.0 / whole_index_bytes
                   << "%" << std::endl;
         stats.add("nodes_bpt", std::to_string(nodes_bpt));
+        stats.add("search", search_name(permutation.third.nodes));
 
         // scan
         {
@@ -294,7 +314,7 @@ void queries(char const* binary_filename, char const* query_filename,
              uint32_t runs, uint64_t num_queries, json_lines& stats,
              std::string const& type) {
     Index index;
-    load(index, binary_filename);
+    rdf::load_index(index, binary_filename);
 
     queries(index.spo(), query_filename, runs, num_queries, index.triplets(),
             index.bytes(), stats, type);
@@ -307,19 +327,18 @@ void queries(char const* binary_filename, char const* query_filename,
 }
 
 int main(int argc, char** argv) {
-    static const uint32_t runs = 5;
-    int mandatory = 3;
+    constexpr uint32_t runs = 5;
+    int mandatory = 2;
 
     if (argc < mandatory) {
-        std::cout
-            << argv[0]
-            << " <type> <index_filename> -q <query_filename> -n <num_queries>"
-            << std::endl;
+        std::cout << argv[0]
+                  << " <index_filename> -q <query_filename> -n <num_queries>"
+                  << std::endl;
         return 1;
     }
 
-    std::string type(argv[1]);  // compact_3t ef_3t pef_3t vb_3t
-    char const* index_filename = argv[2];
+    char const* index_filename = argv[1];
+    std::string type = index_type(index_filename);
     char const* query_filename = nullptr;
     uint64_t num_queries = 0;
 
@@ -344,24 +363,12 @@ int main(int argc, char** argv) {
 
     json_lines stats;
 
-    if (type == "compact_3t") {
-        queries<compact_3t>(index_filename, query_filename, runs, num_queries,
-                            stats, type);
-    } else if (type == "ef_3t") {
-        queries<ef_3t>(index_filename, query_filename, runs, num_queries, stats,
-                       type);
-    } else if (type == "pef_3t") {
-        queries<pef_3t>(index_filename, query_filename, runs, num_queries,
-                        stats, type);
-    } else if (type == "vb_3t") {
-        queries<vb_3t>(index_filename, query_filename, runs, num_queries, stats,
-                       type);
-    } else if (type == "pef_r_3t") {
-        queries<pef_r_3t>(index_filename, query_filename, runs, num_queries,
-                          stats, type);
-    } else {
-        building_util::unknown_type(type);
-    }
+    // only the 3T indexes have the three permutations profiled
+    bool known = dispatch<index_3t_types>(type, [&](auto tag) {
+        queries<typename decltype(tag)::type>(index_filename, query_filename,
+                                              runs, num_queries, stats, type);
+    });
+    if (!known) building_util::unknown_type(type);
 
     stats.print();
 
@@ -116,6 +116,11 @@ int main(int argc, char** argv) {
     pef::pef_parameters params;
     json_lines stats;
 
+    // Decoding a short sequence into an aligned buffer and counting the
+    // values < lower_bound with AVX-512/AVX2 compares was slower than
+    // next_geq at every size: 50 vs 40 ns for n = 8, 80 vs 36 ns for
+    // n = 32, 400 vs 45 ns for n = 128. Decoding is linear in n, while
+    // next_geq only scans the bucket of the lower bound.
     for (uint64_t q = 1; q <= 10; ++q) {
         std::cout << "testing with q = " << (uint64_t(1) << q) << std::endl;
         params.ef_log_sampling0 = q;
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+
 #include "trie.hpp"
 
 namespace rdf {
@@ -49,6 +53,58 @@ struct trie<Mapper, Levels>::iterator {
         return m_val;
     }
 
+    // Write the next (at most) n triples to out and return their number.
+    // Each level decodes its nodes in bulk, across ranges, and the triples
+    // are assembled from them without branching where ranges switch.
+    uint64_t next_batch(triplet* out, uint64_t n) {
+        static const uint64_t buffer_size = 256;
+        uint64_t thirds[buffer_size];
+        uint64_t firsts[buffer_size + 1], seconds[buffer_size + 1];
+        uint32_t third_begins[buffer_size], second_begins[buffer_size + 1];
+
+        n = std::min(n, m_size - m_i);
+        if (n == 0) return 0;
+        out[0] = m_val;
+        for (uint64_t i = 1; i != n;) {
+            uint64_t k = std::min(n - i, buffer_size);
+            uint64_t s = m_third.next_values(thirds, k, third_begins);
+            if (s) m_second.next_values(seconds + 1, s, second_begins + 1);
+            firsts[0] = m_val.first;
+            seconds[0] = m_val.second;
+            for (uint64_t r = 1; r <= s; ++r) {
+                firsts[r] = firsts[r - 1] + second_begins[r];
+            }
+            triplet t;
+            for (uint64_t j = 0, r = 0; j != k; ++j) {
+                r += third_begins[j];
+                t.first = firsts[r];
+                t.second = seconds[r];
+                t.third = thirds[j];
+                t.third = m_mapper.unmap(t);
+                out[i + j] = t;
+            }
+            m_val = out[i + k - 1];
+            i += k;
+        }
+        m_i += n - 1;
+        operator++();
+        return n;
+    }
+
+    // Move to the first triple >= value in the third component among those
+    // sharing the first two components with the current one, and return
+    // true. If there is none, stop on the last of them and return false.
+    bool skip_to(uint64_t value) {
+        triplet t = m_val;
+        t.third = value;
+        uint64_t begin = m_third.position();
+        bool found = m_third.skip_to(m_mapper.map_geq(t));
+        m_i += m_third.position() - begin;
+        m_val.third = *m_third;
+        m_val.third = m_mapper.unmap(m_val);
+        return found;
+    }
+
 private:
     triplet m_val;
     uint64_t m_i;
@@ -59,7 +115,8 @@ private:
 };
 
 template <typename Mapper, typename Levels>
-typename trie<Mapper, Levels>::iterator trie<Mapper, Levels>::select_all() {
+typename trie<Mapper, Levels>::iterator trie<Mapper, Levels>::select_all()
+    const {
     return typename trie<Mapper, Levels>::iterator(
         0,
         typename Levels::second::iterator(second.nodes.begin(),
@@ -71,7 +128,7 @@ typename trie<Mapper, Levels>::iterator trie<Mapper, Levels>::select_all() {
 
 template <typename Mapper, typename Levels>
 typename trie<Mapper, Levels>::iterator trie<Mapper, Levels>::select(
-    triplet const& t) {
+    triplet const& t) const {
     assert(t.first != global::wildcard_symbol);
     assert(t.third == global::wildcard_symbol);
 
@@ -89,12 +146,16 @@ typename trie<Mapper, Levels>::iterator trie<Mapper, Levels>::select(
             second.pointers[r.end - 1].end - second.pointers[r.begin].begin;
     }
 
+    // the cursor that finds t.second also starts the iterator over the
+    // second level, so that its position is not located twice
+    search::range_finder<typename Levels::second::nodes_type> finder(
+        second.nodes, r.begin);
     if (t.second != global::wildcard_symbol) {
-        j = second.nodes.find(r, t.second);
+        j = finder.find(r, t.second);
     }
 
     typename Levels::second::iterator second_level_iterator(
-        second.nodes.at(r, j), first.pointers.at(i));
+        finder.at(r, j), first.pointers.at(i));
 
     i = j;
 
@@ -112,21 +173,23 @@ typename trie<Mapper, Levels>::iterator trie<Mapper, Levels>::select(
                     num_triplets, mapper);
 }
 
+// Returns the triples matching (x,?,y), permuted in (o,s,p) and sorted by
+// predicate, by searching y in the range of every child of x.
+// The ranges are consecutive, so they are searched with one range_finder.
 template <typename Mapper, typename Levels>
 struct trie<Mapper, Levels>::iterator_so {
-    iterator_so(uint64_t first,
+    iterator_so(triplet const& val, uint64_t id,
                 typename Levels::second::iterator const& second_it,
                 typename Levels::third::iterator const& third_it,
-                typename Levels::third::nodes_type& nodes, uint64_t third,
-                uint64_t num_triplets)
-        : m_i(0)
+                typename Levels::third::nodes_type const& nodes,
+                uint64_t begin, uint64_t num_triplets)
+        : m_val(val)
+        , m_id(id)
+        , m_i(0)
         , m_size(num_triplets)
         , m_second(second_it)
         , m_third(third_it)
-        , m_nodes(&nodes) {
-        // permute (s,p,o) in (o,s,p)
-        m_val.first = third;
-        m_val.second = first;
+        , m_finder(nodes, begin) {
         m_val.third = *m_second;
     }
 
@@ -134,7 +197,7 @@ struct trie<Mapper, Levels>::iterator_so {
         while (m_i < m_size) {
             m_val.third = *m_second;
             auto r = m_third.pointer();
-            uint64_t pos = m_nodes->find(r, m_val.first);
+            uint64_t pos = m_finder.find(r, m_id);
             if (pos != global::not_found) return true;
             this->operator++();
         }
@@ -151,19 +214,28 @@ struct trie<Mapper, Levels>::iterator_so {
         return m_val;
     }
 
+    uint64_t next_batch(triplet* out, uint64_t n) {
+        uint64_t i = 0;
+        for (; i != n and has_next(); ++i, operator++()) out[i] = operator*();
+        return i;
+    }
+
 private:
     triplet m_val;
+    uint64_t m_id;
     uint64_t m_i;
     uint64_t m_size;
     typename Levels::second::iterator m_second;
     typename Levels::third::iterator m_third;
-    typename Levels::third::nodes_type* m_nodes;
+    search::range_finder<typename Levels::third::nodes_type> m_finder;
 };
 
+// (s,?,o) on SPO searches o under the predicates of s; (o,?,s) on OPS
+// searches s under the predicates of o. Both return (o,s,p) triples.
 template <typename Mapper, typename Levels>
 typename trie<Mapper, Levels>::iterator_so trie<Mapper, Levels>::select_so(
-    triplet const& t) {
-    assert(id() == permutation_type::spo);
+    triplet const& t) const {
+    assert(id() == permutation_type::spo or id() == permutation_type::ops);
     assert(t.first != global::wildcard_symbol);
     assert(t.second == global::wildcard_symbol);
     assert(t.third != global::wildcard_symbol);
@@ -188,112 +260,284 @@ typename trie<Mapper, Levels>::iterator_so trie<Mapper, Levels>::select_so(
     typename Levels::third::iterator third_level_iterator(
         third.nodes.at(r, j), second.pointers.at(i));
 
-    return iterator_so(t.first, second_level_iterator, third_level_iterator,
-                       third.nodes, t.third, num_triplets);
+    triplet val;
+    val.first = id() == permutation_type::spo ? t.third : t.first;
+    val.second = id() == permutation_type::spo ? t.first : t.third;
+    return iterator_so(val, t.third, second_level_iterator,
+                       third_level_iterator, third.nodes, j, num_triplets);
 }
 
 template <typename Mapper, typename Levels>
-struct trie<Mapper, Levels>::iterator_po {
-    iterator_po(uint64_t second, trie<Mapper, Levels>* data)
-        : m_i(0)
-        , m_j(0)
-        , m_size((data->first).size())
-        , m_range_len(0)
-        , m_trie(data) {
-        // permute (s,p,o) in (p,s,o)
-        m_val.first = second;
-        m_val.second = 0;
-        m_val.third = 0;
-
-        m_second_it = typename Levels::second::iterator(
-            (m_trie->second).nodes.begin(), (m_trie->first).pointers.begin());
+uint64_t trie<Mapper, Levels>::is_member(triplet const& t) const {
+    assert(t.first != global::wildcard_symbol);
+    assert(t.second != global::wildcard_symbol);
+    assert(t.third != global::wildcard_symbol);
+
+    uint64_t i = t.first;
+    range r = first.pointers[i];
+    uint64_t j = second.nodes.find(r, t.second);
+    if (j == global::not_found) {
+        return j;
     }
 
-    bool has_next() {
-        while (m_j < m_range_len) {
-            return true;
-        }
+    i = j;
+    r = second.pointers[i];
+    uint64_t mapped = mapper.map(t);
+    j = third.nodes.find(r, mapped);
+    return j;
+}
 
-        bool found = false;
-        while (!found && m_i < m_size) {
-            auto r = m_second_it.pointer();
-            uint64_t pos = (m_trie->second).nodes.find(r, m_val.first);
-            if (pos != global::not_found) {
-                m_val.second = m_i;
-                auto r = (m_trie->second).pointers[pos];
-                m_j = 0;
-                m_range_len = r.end - r.begin;
-                m_third_it = typename Levels::third::iterator(
-                    (m_trie->third).nodes.at(r, r.begin),
-                    (m_trie->second).pointers.at(pos));
-                found = true;
-            }
+// Count the triples matching t, that can only have trailing wildcards.
+// The third level is accessed only if t has no wildcards.
+template <typename Mapper, typename Levels>
+uint64_t trie<Mapper, Levels>::count(triplet const& t) const {
+    assert(t.first != global::wildcard_symbol);
+    assert(t.second != global::wildcard_symbol or
+           t.third == global::wildcard_symbol);
+
+    if (t.first >= first.size()) return 0;
+    range r = first.pointers[t.first];
+    if (t.second == global::wildcard_symbol) {
+        return second.pointers.access(r.end) -
+               second.pointers.access(r.begin);
+    }
+
+    uint64_t j = second.nodes.find(r, t.second);
+    if (j == global::not_found) return 0;
+    r = second.pointers[j];
+    if (t.third == global::wildcard_symbol) return r.end - r.begin;
+    return third.nodes.find(r, mapper.map(t)) != global::not_found;
+}
+
+// Count the triples matching (x,?,z), probing the range of z for every
+// child of x.
+template <typename Mapper, typename Levels>
+uint64_t trie<Mapper, Levels>::count_so(triplet const& t) const {
+    assert(t.first != global::wildcard_symbol);
+    assert(t.second == global::wildcard_symbol);
+    assert(t.third != global::wildcard_symbol);
+
+    if (t.first >= first.size()) return 0;
+    range r = first.pointers[t.first];
+    typename Levels::second::iterator second_it(second.nodes.at(r, r.begin),
+                                                first.pointers.at(t.first));
+    search::range_finder<typename Levels::third::nodes_type> finder(
+        third.nodes, second.pointers.access(r.begin));
+    triplet q = t;
+    uint64_t n = 0;
+    for (uint64_t j = r.begin; j != r.end; ++j) {
+        q.second = *second_it;
+        n += finder.find(second.pointers[j], mapper.map(q)) !=
+             global::not_found;
+        if (j + 1 != r.end) ++second_it;
+    }
+    return n;
+}
+
+// A trie iterator in the sense of leapfrog triejoin: at each depth it
+// enumerates the keys of the current range in sorted order and can seek
+// forward to the first key >= a given one. open() descends to the children
+// of the current key and up() goes back to the parent. The first level
+// enumerates all the ids, as its nodes are implicit.
+template <typename Mapper, typename Levels>
+struct trie<Mapper, Levels>::cursor {
+    cursor(trie const& t) : m_trie(&t), m_depth(0) {}
+
+    // the level of the current key: 1, 2 or 3 (0 before the first open)
+    uint32_t depth() const {
+        return m_depth;
+    }
 
-            m_second_it.next_pointer();
-            ++m_i;
+    void open() {
+        assert(m_depth < 3);
+        assert(m_depth == 0 or !at_end());
+        switch (m_depth) {
+            case 0:
+                m_ranges[0] = {0, m_trie->first.size()};
+                m_pos[0] = m_ranges[0].begin;
+                break;
+            case 1:
+                m_ranges[1] = m_trie->first.pointers[m_keys[0]];
+                m_pos[1] = m_ranges[1].begin;
+                break;
+            case 2:
+                m_ranges[2] = m_trie->second.pointers[m_pos[1]];
+                m_pos[2] = m_ranges[2].begin;
+                break;
         }
+        ++m_depth;
+        read();
+    }
 
-        return found;
+    void up() {
+        assert(m_depth > 0);
+        --m_depth;
     }
 
-    void operator++() {
-        ++m_j;
-        ++m_third_it;
+    bool at_end() const {
+        uint32_t d = level();
+        return m_pos[d] == m_ranges[d].end;
     }
 
-    triplet operator*() {
-        m_val.third = *m_third_it;
-        return m_val;
+    uint64_t key() const {
+        assert(!at_end());
+        return m_keys[level()];
+    }
+
+    void next() {
+        assert(!at_end());
+        ++m_pos[level()];
+        read();
+    }
+
+    // move to the first key >= k of the current range
+    void seek(uint64_t k) {
+        assert(!at_end());
+        uint32_t d = level();
+        if (k <= m_keys[d]) return;
+        range const& r = m_ranges[d];
+        switch (m_depth) {
+            case 1:
+                m_pos[0] = std::min(k, r.end);
+                break;
+            case 2:
+                m_pos[1] = m_trie->second.nodes.next_geq(r, m_pos[1], k);
+                break;
+            case 3: {
+                triplet t;
+                t.first = m_keys[0];
+                t.second = m_keys[1];
+                t.third = k;
+                m_pos[2] = m_trie->third.nodes.next_geq(
+                    r, m_pos[2], m_trie->mapper.map_geq(t));
+                break;
+            }
+        }
+        read();
     }
 
 private:
-    triplet m_val;
-    uint64_t m_i;
-    uint64_t m_j;
-    uint64_t m_size;
-    uint64_t m_range_len;
-    trie<Mapper, Levels>* m_trie;
-    typename Levels::second::iterator m_second_it;
-    typename Levels::third::iterator m_third_it;
+    trie const* m_trie;
+    uint32_t m_depth;
+    range m_ranges[3];
+    uint64_t m_pos[3];
+    uint64_t m_keys[3];
+
+    // the index of the current depth in the arrays above, that the
+    // compiler is told to be in [0, 3)
+    uint32_t level() const {
+        assert(m_depth > 0 and m_depth <= 3);
+        if (m_depth == 0 or m_depth > 3) __builtin_unreachable();
+        return m_depth - 1;
+    }
+
+    void read() {
+        if (at_end()) return;
+        switch (m_depth) {
+            case 1:
+                m_keys[0] = m_pos[0];
+                break;
+            case 2:
+                m_keys[1] = m_trie->second.nodes.access(m_ranges[1], m_pos[1]);
+                break;
+            case 3: {
+                triplet t;
+                t.first = m_keys[0];
+                t.second = m_keys[1];
+                t.third = m_trie->third.nodes.access(m_ranges[2], m_pos[2]);
+                m_keys[2] = m_trie->mapper.unmap(t);
+                break;
+            }
+        }
+    }
 };
 
 template <typename Mapper, typename Levels>
-typename trie<Mapper, Levels>::iterator_po trie<Mapper, Levels>::select_p(
-    triplet const& t) {
-    assert(id() == permutation_type::spo);
-    assert(t.first == global::wildcard_symbol);
-    assert(t.second != global::wildcard_symbol);
-    assert(t.third == global::wildcard_symbol);
-    return iterator_po(t.second, this);
+typename trie<Mapper, Levels>::cursor trie<Mapper, Levels>::open_cursor()
+    const {
+    return cursor(*this);
 }
 
-template <typename Mapper, typename Levels>
-typename trie<Mapper, Levels>::iterator_po trie<Mapper, Levels>::select_o(
-    triplet const& t) {
-    assert(id() == permutation_type::pos);
-    assert(t.first == global::wildcard_symbol);
-    assert(t.second != global::wildcard_symbol);
-    assert(t.third == global::wildcard_symbol);
-    return iterator_po(t.second, this);
-}
+namespace global {
+// number of queries to look ahead when prefetching in batched lookups
+static const uint64_t prefetch_distance = 16;
+}  // namespace global
 
+// Batched is_member: out[i] = is_member(queries[i]).
+// Queries are visited in sorted order, so that those sharing a subject
+// (and a predicate) share the lookups in the first (and second) level.
 template <typename Mapper, typename Levels>
-uint64_t trie<Mapper, Levels>::is_member(triplet const& t) {
-    assert(t.first != global::wildcard_symbol);
-    assert(t.second != global::wildcard_symbol);
-    assert(t.third != global::wildcard_symbol);
+void trie<Mapper, Levels>::is_member(triplet const* queries, uint64_t n,
+                                     uint64_t* out) const {
+    // Sort (query, position) pairs by query. Large batches are first
+    // bucketed by their first component with a counting sort (the domain
+    // is the number of first-level nodes), leaving small groups to sort.
+    struct entry {
+        triplet t;
+        uint64_t i;
+    };
+    auto less = [](entry const& x, entry const& y) {
+        return std::tie(x.t.first, x.t.second, x.t.third) <
+               std::tie(y.t.first, y.t.second, y.t.third);
+    };
+    // queries whose first component has no node are not members, and are
+    // left out of the sort
+    uint64_t domain = first.size();
+    uint64_t m = 0;
+    for (uint64_t i = 0; i != n; ++i) {
+        if (queries[i].first < domain) {
+            ++m;
+        } else {
+            out[i] = global::not_found;
+        }
+    }
 
-    uint64_t i = t.first;
-    range r = first.pointers[i];
-    uint64_t j = second.nodes.find(r, t.second);
-    if (j == global::not_found) {
-        return j;
+    std::vector<entry> sorted(m);
+    if (m < domain) {
+        for (uint64_t i = 0, k = 0; i != n; ++i) {
+            if (queries[i].first < domain) sorted[k++] = {queries[i], i};
+        }
+        std::sort(sorted.begin(), sorted.end(), less);
+    } else {
+        std::vector<uint64_t> offsets(domain + 1, 0);
+        for (uint64_t i = 0; i != n; ++i) {
+            if (queries[i].first < domain) ++offsets[queries[i].first + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        for (uint64_t i = 0; i != n; ++i) {
+            if (queries[i].first < domain) {
+                sorted[offsets[queries[i].first]++] = {queries[i], i};
+            }
+        }
+        for (uint64_t b = 0; b != m;) {
+            uint64_t e = b + 1;
+            while (e != m and sorted[e].t.first == sorted[b].t.first) ++e;
+            std::sort(sorted.begin() + b, sorted.begin() + e, less);
+            b = e;
+        }
     }
 
-    i = j;
-    r = second.pointers[i];
-    uint64_t mapped = mapper.map(t);
-    j = third.nodes.find(r, mapped);
-    return j;
+    range r1 = {0, 0};
+    range r2 = {0, 0};
+    uint64_t j = global::not_found;
+    for (uint64_t k = 0; k != m; ++k) {
+        if (k + global::prefetch_distance < m) {
+            first.pointers.prefetch(
+                sorted[k + global::prefetch_distance].t.first);
+        }
+
+        triplet const& t = sorted[k].t;
+        triplet const* prev = k ? &sorted[k - 1].t : nullptr;
+        bool same_first = prev and prev->first == t.first;
+        if (!same_first) r1 = first.pointers[t.first];
+        if (!same_first or prev->second != t.second) {
+            j = second.nodes.find(r1, t.second);
+            if (j != global::not_found) r2 = second.pointers[j];
+        }
+
+        out[sorted[k].i] = j == global::not_found
+                            ? global::not_found
+                            : third.nodes.find(r2, mapper.map(t));
+    }
 }
 }  // namespace rdf
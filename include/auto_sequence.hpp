@@ -0,0 +1,484 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include "compact_vector.hpp"
+#include "block_sequence.hpp"
+#include "parameters.hpp"
+#include "ef/ef_sequence.hpp"
+#include "pef/pef_sequence.hpp"
+#include "vb/vb.hpp"
+#include "util_types.hpp"
+
+namespace rdf {
+
+// A sequence encoded with the codec that best trades space for speed on
+// its own data. At build time, a sample of the ranges of the sequence is
+// encoded with every codec, and access, find and scan are timed on it:
+// the chosen codec minimizes
+//
+//   space_weight * log(space / min_space) +
+//   (1 - space_weight) * mean over the operations of log(time / min_time),
+//
+// where the minima are taken over the codecs: on a log scale, the time
+// ratios between codecs (up to a few hundred) do not swamp the space
+// ratios (a few units). The whole sequence is then encoded once, with the
+// chosen codec. The choice is serialized with the sequence and every
+// operation dispatches on it.
+struct auto_sequence {
+    enum codec_type {
+        compact = 0,
+        elias_fano = 1,
+        partitioned_elias_fano = 2,
+        variable_byte = 3,
+        num_codecs = 4
+    };
+
+    typedef block_sequence<vb::maskedvbyte_block, vb::vbyte64_block>
+        vb_sequence;
+
+    struct objective {
+        objective(parameters const& params)
+            : space_weight(params.space_weight)
+            , sample_ranges(1000)
+            , sample_nodes(1 << 20)
+            , runs(3) {}
+
+        double space_weight;  // in [0, 1]
+        uint64_t sample_ranges;
+        uint64_t sample_nodes;  // at most, unless a single range has more
+        uint64_t runs;          // the minimum time of these runs is taken
+    };
+
+    // the space, in bits per node, and the time, in nanoseconds per
+    // access, per find and per scanned node, of a codec on the sample
+    struct cost {
+        double space;
+        double times[3];
+    };
+
+    static char const* codec_name(uint8_t type) {
+        static char const* names[] = {"compact_vector", "ef_sequence",
+                                      "pef_sequence", "vb_sequence"};
+        return names[type];
+    }
+
+    // the codec minimizing the objective, given the costs of all codecs
+    static uint8_t choose(cost const* costs, double space_weight) {
+        assert(space_weight >= 0.0 and space_weight <= 1.0);
+        double min_space = costs[0].space;
+        double min_times[3];
+        std::copy(costs[0].times, costs[0].times + 3, min_times);
+        for (int c = 1; c != num_codecs; ++c) {
+            min_space = std::min(min_space, costs[c].space);
+            for (int op = 0; op != 3; ++op) {
+                min_times[op] = std::min(min_times[op], costs[c].times[op]);
+            }
+        }
+        uint8_t best = compact;
+        double best_score = 0.0;
+        for (int c = 0; c != num_codecs; ++c) {
+            double time_score = 0.0;
+            for (int op = 0; op != 3; ++op) {
+                time_score += std::log(costs[c].times[op] / min_times[op]) / 3;
+            }
+            double score =
+                space_weight * std::log(costs[c].space / min_space) +
+                (1.0 - space_weight) * time_score;
+            if (c == 0 or score < best_score) {
+                best_score = score;
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    auto_sequence() : m_type(compact) {}
+
+    void build(compact_vector::builder& from,
+               compact_vector::builder const& pointers, objective const& o) {
+        assert(o.space_weight >= 0.0 and o.space_weight <= 1.0);
+
+        // sample ranges, in the order of the sequence
+        std::vector<range> ranges;
+        auto pointers_it = pointers.begin();
+        uint64_t begin = *pointers_it;
+        for (uint64_t i = 1; i < pointers.size(); ++i) {
+            ++pointers_it;
+            uint64_t end = *pointers_it;
+            if (end > begin) ranges.push_back({begin, end});
+            begin = end;
+        }
+        std::mt19937_64 rng(13);
+        std::shuffle(ranges.begin(), ranges.end(), rng);
+        std::vector<range> sample;
+        uint64_t nodes = 0;
+        for (auto const& r : ranges) {
+            if (sample.size() == o.sample_ranges) break;
+            uint64_t n = r.end - r.begin;
+            if (sample.size() and nodes + n > o.sample_nodes) continue;
+            sample.push_back(r);
+            nodes += n;
+        }
+        std::sort(sample.begin(), sample.end(),
+                  [](range const& x, range const& y) {
+                      return x.begin < y.begin;
+                  });
+
+        if (sample.empty()) {  // nothing to choose on
+            m_type = compact;
+            m_cv.build(from, pointers);
+            return;
+        }
+
+        cost costs[num_codecs];
+        sample_costs(from, sample, nodes, o, rng, costs);
+        m_type = choose(costs, o.space_weight);
+        std::cout << "codec " << codec_name(m_type) << ": "
+                  << costs[m_type].space << " bits per node, "
+                  << costs[m_type].times[0] << " [ns/access], "
+                  << costs[m_type].times[1] << " [ns/find], "
+                  << costs[m_type].times[2] << " [ns/scan] on the sample"
+                  << std::endl;
+
+        switch (m_type) {
+            case compact:
+                m_cv.build(from, pointers);
+                break;
+            case elias_fano:
+                m_ef.build(from, pointers);
+                break;
+            case partitioned_elias_fano:
+                m_pef.build(from, pointers);
+                break;
+            default:
+                m_vb.build(from, pointers);
+        }
+    }
+
+    struct iterator {
+        iterator() {}
+
+        iterator(compact_vector::iterator const& it)
+            : m_type(compact), m_cv(it) {}
+        iterator(ef::ef_sequence::iterator const& it)
+            : m_type(elias_fano), m_ef(it) {}
+        iterator(pef::pef_sequence::iterator const& it)
+            : m_type(partitioned_elias_fano), m_pef(it) {}
+        iterator(vb_sequence::iterator const& it)
+            : m_type(variable_byte), m_vb(it) {}
+
+        void operator++() {
+            switch (m_type) {
+                case compact:
+                    ++m_cv;
+                    break;
+                case elias_fano:
+                    ++m_ef;
+                    break;
+                case partitioned_elias_fano:
+                    ++m_pef;
+                    break;
+                default:
+                    ++m_vb;
+            }
+        }
+
+        uint64_t value() {
+            switch (m_type) {
+                case compact:
+                    return m_cv.value();
+                case elias_fano:
+                    return m_ef.value();
+                case partitioned_elias_fano:
+                    return m_pef.value();
+                default:
+                    return m_vb.value();
+            }
+        }
+
+        void switch_range() {
+            switch (m_type) {
+                case compact:
+                    m_cv.switch_range();
+                    break;
+                case elias_fano:
+                    m_ef.switch_range();
+                    break;
+                case partitioned_elias_fano:
+                    m_pef.switch_range();
+                    break;
+                default:
+                    m_vb.switch_range();
+            }
+        }
+
+        void next_values(uint64_t* out, uint64_t n, uint32_t const* begins) {
+            switch (m_type) {
+                case compact:
+                    m_cv.next_values(out, n, begins);
+                    break;
+                case elias_fano:
+                    m_ef.next_values(out, n, begins);
+                    break;
+                case partitioned_elias_fano:
+                    m_pef.next_values(out, n, begins);
+                    break;
+                default:
+                    m_vb.next_values(out, n, begins);
+            }
+        }
+
+        uint64_t next_geq(range const& r, uint64_t lower_bound) {
+            switch (m_type) {
+                case compact:
+                    return m_cv.next_geq(r, lower_bound);
+                case elias_fano:
+                    return m_ef.next_geq(r, lower_bound);
+                case partitioned_elias_fano:
+                    return m_pef.next_geq(r, lower_bound);
+                default:
+                    return m_vb.next_geq(r, lower_bound);
+            }
+        }
+
+    private:
+        uint8_t m_type;
+        compact_vector::iterator m_cv;
+        ef::ef_sequence::iterator m_ef;
+        pef::pef_sequence::iterator m_pef;
+        vb_sequence::iterator m_vb;
+    };
+
+    iterator begin() const {
+        switch (m_type) {
+            case compact:
+                return m_cv.begin();
+            case elias_fano:
+                return m_ef.begin();
+            case partitioned_elias_fano:
+                return m_pef.begin();
+            default:
+                return m_vb.begin();
+        }
+    }
+
+    iterator at(range const& r, uint64_t pos) const {
+        switch (m_type) {
+            case compact:
+                return m_cv.at(r, pos);
+            case elias_fano:
+                return m_ef.at(r, pos);
+            case partitioned_elias_fano:
+                return m_pef.at(r, pos);
+            default:
+                return m_vb.at(r, pos);
+        }
+    }
+
+    uint64_t access(range const& r, uint64_t pos) const {
+        switch (m_type) {
+            case compact:
+                return m_cv.access(r, pos);
+            case elias_fano:
+                return m_ef.access(r, pos);
+            case partitioned_elias_fano:
+                return m_pef.access(r, pos);
+            default:
+                return m_vb.access(r, pos);
+        }
+    }
+
+    uint64_t find(range const& r, uint64_t id) const {
+        switch (m_type) {
+            case compact:
+                return m_cv.find(r, id);
+            case elias_fano:
+                return m_ef.find(r, id);
+            case partitioned_elias_fano:
+                return m_pef.find(r, id);
+            default:
+                return m_vb.find(r, id);
+        }
+    }
+
+    // position of the first element >= id in [pos, r.end), or r.end
+    uint64_t next_geq(range const& r, uint64_t pos, uint64_t id) const {
+        switch (m_type) {
+            case compact:
+                return m_cv.next_geq(r, pos, id);
+            case elias_fano:
+                return m_ef.next_geq(r, pos, id);
+            case partitioned_elias_fano:
+                return m_pef.next_geq(r, pos, id);
+            default:
+                return m_vb.next_geq(r, pos, id);
+        }
+    }
+
+    uint64_t size() const {
+        switch (m_type) {
+            case compact:
+                return m_cv.size();
+            case elias_fano:
+                return m_ef.size();
+            case partitioned_elias_fano:
+                return m_pef.size();
+            default:
+                return m_vb.size();
+        }
+    }
+
+    uint8_t type() const {
+        return m_type;
+    }
+
+    // as saved by visit, with the chosen codec only
+    uint64_t bytes() const {
+        switch (m_type) {
+            case compact:
+                return sizeof(m_type) + m_cv.bytes();
+            case elias_fano:
+                return sizeof(m_type) + m_ef.bytes();
+            case partitioned_elias_fano:
+                return sizeof(m_type) + m_pef.bytes();
+            default:
+                return sizeof(m_type) + m_vb.bytes();
+        }
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_type);
+        switch (m_type) {
+            case compact:
+                visitor.visit(m_cv);
+                break;
+            case elias_fano:
+                visitor.visit(m_ef);
+                break;
+            case partitioned_elias_fano:
+                visitor.visit(m_pef);
+                break;
+            case variable_byte:
+                visitor.visit(m_vb);
+                break;
+            default:
+                assert(false);
+        }
+    }
+
+private:
+    uint8_t m_type;
+    compact_vector m_cv;
+    ef::ef_sequence m_ef;
+    pef::pef_sequence m_pef;
+    vb_sequence m_vb;
+
+    // Encode the sampled ranges of from, that hold nodes values, with
+    // every codec, and time the operations on them.
+    static void sample_costs(compact_vector::builder const& from,
+                             std::vector<range> const& sample, uint64_t nodes,
+                             objective const& o, std::mt19937_64& rng,
+                             cost* costs) {
+        compact_vector::builder values(nodes, from.width());
+        compact_vector::builder pointers(sample.size() + 1,
+                                         util::ceil_log2(nodes + 1));
+        std::vector<range> ranges;  // the sample, in values
+        pointers.push_back(0);
+        for (auto const& r : sample) {
+            compact_vector::builder::iterator it(&from, r.begin);
+            for (uint64_t pos = r.begin; pos != r.end; ++pos, ++it) {
+                values.push_back(*it);
+            }
+            uint64_t begin = ranges.size() ? ranges.back().end : 0;
+            ranges.push_back({begin, begin + r.end - r.begin});
+            pointers.push_back(ranges.back().end);
+        }
+
+        // a position in every range and its value
+        std::vector<uint64_t> positions, ids;
+        compact_vector cv;
+        cv.build(values, pointers);  // consumes values, so it is read last
+        for (auto const& r : ranges) {
+            positions.push_back(r.begin + rng() % (r.end - r.begin));
+            ids.push_back(cv.access(r, positions.back()));
+        }
+
+        compact_vector::builder copy(cv.begin(), nodes, from.width());
+        ef::ef_sequence ef;
+        pef::pef_sequence pef;
+        vb_sequence vb;
+        ef.build(copy, pointers);
+        pef.build(copy, pointers);
+        vb.build(copy, pointers);
+
+        costs[compact].space = cv.bytes() * 8.0 / nodes;
+        costs[elias_fano].space = ef.bytes() * 8.0 / nodes;
+        costs[partitioned_elias_fano].space = pef.bytes() * 8.0 / nodes;
+        costs[variable_byte].space = vb.bytes() * 8.0 / nodes;
+        measure(cv, ranges, positions, ids, o.runs, costs[compact].times);
+        measure(ef, ranges, positions, ids, o.runs, costs[elias_fano].times);
+        measure(pef, ranges, positions, ids, o.runs,
+                costs[partitioned_elias_fano].times);
+        measure(vb, ranges, positions, ids, o.runs,
+                costs[variable_byte].times);
+    }
+
+    // the minimum time over the runs, in nanoseconds per access, per find
+    // and per scanned node
+    template <typename Sequence>
+    static void measure(Sequence const& s, std::vector<range> const& ranges,
+                        std::vector<uint64_t> const& positions,
+                        std::vector<uint64_t> const& ids, uint64_t runs,
+                        double* times) {
+        typedef std::chrono::high_resolution_clock clock_type;
+        auto elapsed = [](clock_type::time_point start) {
+            return std::chrono::duration<double, std::nano>(clock_type::now() -
+                                                            start)
+                .count();
+        };
+        uint64_t n = ranges.size();
+        uint64_t scanned = 0;
+        for (auto const& r : ranges) scanned += r.end - r.begin;
+        std::fill(times, times + 3, std::numeric_limits<double>::max());
+
+        for (uint64_t run = 0; run != runs; ++run) {
+            auto start = clock_type::now();
+            for (uint64_t i = 0; i != n; ++i) {
+                auto x = s.access(ranges[i], positions[i]);
+                essentials::do_not_optimize_away(x);
+            }
+            times[0] = std::min(times[0], elapsed(start) / n);
+
+            start = clock_type::now();
+            for (uint64_t i = 0; i != n; ++i) {
+                auto x = s.find(ranges[i], ids[i]);
+                essentials::do_not_optimize_away(x);
+            }
+            times[1] = std::min(times[1], elapsed(start) / n);
+
+            start = clock_type::now();
+            for (auto const& r : ranges) {
+                auto it = s.at(r, r.begin);
+                for (uint64_t pos = r.begin; pos != r.end; ++pos, ++it) {
+                    auto x = it.value();
+                    essentials::do_not_optimize_away(x);
+                }
+            }
+            times[2] = std::min(times[2], elapsed(start) / scanned);
+        }
+        for (int op = 0; op != 3; ++op) times[op] = std::max(times[op], 1.0);
+    }
+};
+
+// the levels of auto_3t take their objective from the parameters
+inline void build_sequence(auto_sequence& nodes, compact_vector::builder& from,
+                           compact_vector::builder const& pointers,
+                           parameters const& params) {
+    nodes.build(from, pointers, auto_sequence::objective(params));
+}
+
+}  // namespace rdf
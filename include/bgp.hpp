@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include "util.hpp"
+#include "util_types.hpp"
+
+namespace rdf {
+
+// A component of a triple pattern: either a constant id or a variable,
+// with variables numbered from 0.
+struct term {
+    static term constant(uint64_t id) {
+        return {id, false};
+    }
+
+    static term variable(uint64_t v) {
+        return {v, true};
+    }
+
+    uint64_t value;
+    bool is_variable;
+};
+
+struct triple_pattern {
+    term const& operator[](uint32_t i) const {
+        assert(i < 3);
+        return i == 0 ? s : (i == 1 ? p : o);
+    }
+
+    term s, p, o;
+};
+
+// A basic graph pattern, i.e., a conjunction of triple patterns sharing
+// variables. Solutions are streamed with index nested-loop joins: the
+// patterns are ordered greedily, preferring those connected to the
+// variables bound so far and then the most selective according to
+// count_upper_bound; each pattern is then selected from the index once per
+// binding of its bound variables, unless count_upper_bound excludes any
+// match. Patterns whose variables are all bound by the previous ones are
+// checked with count.
+template <typename Index>
+struct bgp {
+    bgp(Index const& index, std::vector<triple_pattern> const& patterns)
+        : m_index(&index), m_num_variables(0) {
+        for (auto const& pattern : patterns) {
+            for (uint32_t i = 0; i != 3; ++i) {
+                if (pattern[i].is_variable) {
+                    m_num_variables =
+                        std::max(m_num_variables, pattern[i].value + 1);
+                }
+            }
+        }
+        plan(patterns);
+    }
+
+    struct iterator {
+        iterator(bgp const& query)
+            : m_query(&query)
+            , m_bindings(query.m_num_variables, global::wildcard_symbol)
+            , m_empty_solution(false) {
+            auto const& steps = query.m_steps;
+            m_its.reserve(steps.size());
+            m_perms.resize(steps.size());
+            for (auto const& pattern : query.m_constants) {
+                if (!query.is_member(pattern, m_bindings)) return;
+            }
+            // with constant patterns only, the solution binds no variable
+            if (steps.empty()) {
+                m_empty_solution = true;
+                return;
+            }
+            if (open(0)) next();
+        }
+
+        bool has_next() const {
+            return m_empty_solution or !m_its.empty();
+        }
+
+        // the values of the variables, indexed by variable
+        std::vector<uint64_t> const& operator*() const {
+            return m_bindings;
+        }
+
+        void operator++() {
+            m_empty_solution = false;
+            next();
+        }
+
+    private:
+        bgp const* m_query;
+        std::vector<uint64_t> m_bindings;
+        std::vector<typename Index::iterator> m_its;
+        std::vector<int> m_perms;
+        bool m_empty_solution;
+
+        void next() {
+            auto const& steps = m_query->m_steps;
+            while (!m_its.empty()) {
+                uint64_t k = m_its.size() - 1;
+                auto& it = m_its.back();
+                if (!it.has_next()) {
+                    m_its.pop_back();
+                    continue;
+                }
+                triplet t = *it;
+                ++it;
+                util::unpermute(t, m_perms[k]);
+                if (!bind(steps[k], t)) continue;
+                if (k + 1 == steps.size()) return;
+                open(k + 1);
+            }
+        }
+
+        bool open(uint64_t k) {
+            auto const& s = m_query->m_steps[k];
+            for (auto v : s.variables) m_bindings[v] = global::wildcard_symbol;
+            triplet t = m_query->instantiate(s.pattern, m_bindings);
+            if (m_query->m_index->count_upper_bound(t) == 0) return false;
+            if (num_wildcards(t) == 3) {
+                m_perms[k] = permutation_type::spo;
+                m_its.push_back(m_query->m_index->select_all());
+                return true;
+            }
+            m_perms[k] = Index::select_permutation(t);
+            m_its.push_back(m_query->m_index->select(t));
+            return true;
+        }
+
+        bool bind(typename bgp::step const& s, triplet const& t) {
+            for (auto v : s.variables) m_bindings[v] = global::wildcard_symbol;
+            for (uint32_t i = 0; i != 3; ++i) {
+                if (!s.pattern[i].is_variable) continue;
+                uint64_t& value = m_bindings[s.pattern[i].value];
+                if (value == global::wildcard_symbol) {
+                    value = t[i];
+                } else if (value != t[i]) {
+                    // a variable repeated within the pattern
+                    return false;
+                }
+            }
+            for (auto const& pattern : s.filters) {
+                if (!m_query->is_member(pattern, m_bindings)) return false;
+            }
+            return true;
+        }
+    };
+
+    iterator select() const {
+        return iterator(*this);
+    }
+
+    uint64_t variables() const {
+        return m_num_variables;
+    }
+
+private:
+    struct step {
+        triple_pattern pattern;
+        std::vector<uint64_t> variables;       // bound by this step
+        std::vector<triple_pattern> filters;  // fully bound after this step
+    };
+
+    Index const* m_index;
+    uint64_t m_num_variables;
+    std::vector<step> m_steps;
+    std::vector<triple_pattern> m_constants;
+
+    void plan(std::vector<triple_pattern> const& patterns) {
+        std::vector<bool> bound(m_num_variables, false);
+        std::vector<bool> used(patterns.size(), false);
+        std::vector<uint64_t> unbound(m_num_variables,
+                                      global::wildcard_symbol);
+
+        for (uint64_t i = 0; i != patterns.size(); ++i) {
+            if (!patterns[i][0].is_variable and
+                !patterns[i][1].is_variable and
+                !patterns[i][2].is_variable) {
+                m_constants.push_back(patterns[i]);
+                used[i] = true;
+            }
+        }
+
+        while (true) {
+            // (disconnected, unbound components, estimated cardinality)
+            typedef std::tuple<bool, uint32_t, uint64_t> cost_type;
+            uint64_t best = patterns.size();
+            cost_type best_cost;
+            for (uint64_t i = 0; i != patterns.size(); ++i) {
+                if (used[i]) continue;
+                bool connected = false;
+                uint32_t free = 0;
+                for (uint32_t j = 0; j != 3; ++j) {
+                    auto const& c = patterns[i][j];
+                    if (!c.is_variable) continue;
+                    if (bound[c.value]) {
+                        connected = true;
+                    } else {
+                        ++free;
+                    }
+                }
+                cost_type cost(
+                    !connected, free,
+                    m_index->count_upper_bound(
+                        instantiate(patterns[i], unbound)));
+                if (best == patterns.size() or cost < best_cost) {
+                    best = i;
+                    best_cost = cost;
+                }
+            }
+            if (best == patterns.size()) break;
+
+            step s;
+            s.pattern = patterns[best];
+            used[best] = true;
+            for (uint32_t j = 0; j != 3; ++j) {
+                auto const& c = s.pattern[j];
+                if (c.is_variable and !bound[c.value]) {
+                    bound[c.value] = true;
+                    s.variables.push_back(c.value);
+                }
+            }
+            for (uint64_t i = 0; i != patterns.size(); ++i) {
+                if (used[i]) continue;
+                bool all_bound = true;
+                for (uint32_t j = 0; j != 3; ++j) {
+                    auto const& c = patterns[i][j];
+                    if (c.is_variable and !bound[c.value]) all_bound = false;
+                }
+                if (all_bound) {
+                    s.filters.push_back(patterns[i]);
+                    used[i] = true;
+                }
+            }
+            m_steps.push_back(s);
+        }
+    }
+
+    // replace the variables with their bindings, or with wildcards when
+    // not bound yet
+    triplet instantiate(triple_pattern const& pattern,
+                        std::vector<uint64_t> const& bindings) const {
+        triplet t;
+        for (uint32_t i = 0; i != 3; ++i) {
+            t[i] = pattern[i].is_variable ? bindings[pattern[i].value]
+                                          : pattern[i].value;
+        }
+        return t;
+    }
+
+    bool is_member(triple_pattern const& pattern,
+                   std::vector<uint64_t> const& bindings) const {
+        return m_index->count(instantiate(pattern, bindings)) != 0;
+    }
+};
+
+}  // namespace rdf
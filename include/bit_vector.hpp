@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <vector>
 
+#include "mappable_vector.hpp"
 #include "util.hpp"
 
 // code based on succinct/bit_vector.hpp by Giuseppe Ottaviano
@@ -66,7 +67,8 @@ private:
 };
 
 struct bit_vector_builder {
-    bit_vector_builder(uint64_t size = 0, bool init = 0) : m_size(size) {
+    bit_vector_builder(uint64_t size = 0, bool init = 0)
+        : m_size(size), m_cur_word(nullptr) {
         m_bits.resize(essentials::words_for(size), uint64_t(-init));
         if (size) {
             m_cur_word = &m_bits.back();
@@ -200,7 +202,7 @@ struct bit_vector {
 
     void build(bit_vector_builder* in) {
         m_size = in->size();
-        m_bits.swap(in->data());
+        m_bits.steal(in->data());
     }
 
     bit_vector(bit_vector_builder* in) {
@@ -217,7 +219,7 @@ struct bit_vector {
     }
 
     uint64_t bytes() const {
-        return sizeof(m_size) + essentials::vec_bytes(m_bits);
+        return sizeof(m_size) + m_bits.bytes();
     }
 
     // get i-th bit
@@ -278,7 +280,7 @@ struct bit_vector {
         return block * 64 + ret;
     }
 
-    std::vector<uint64_t> const& data() const {
+    mappable_vector<uint64_t> const& data() const {
         return m_bits;
     }
 
@@ -356,6 +358,6 @@ struct bit_vector {
 
 private:
     size_t m_size;
-    std::vector<uint64_t> m_bits;
+    mappable_vector<uint64_t> m_bits;
 };
 }  // namespace rdf
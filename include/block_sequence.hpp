@@ -1,71 +1,31 @@
 #pragma once
 
+#include <limits>
+
 namespace rdf {
 
-template <typename Block>
+// Blocks of gaps, that are encoded with Block if all the values fit in 32
+// bits, or else with WideBlock. The choice is made per sequence, so that
+// only the sequences that need 64-bit values pay for them.
+template <typename Block, typename WideBlock>
 struct block_sequence {
+    static_assert(Block::block_size == WideBlock::block_size,
+                  "blocks must have the same size");
     typedef uint64_t endpoint_type;
-    typedef uint32_t upperbound_type;
+    static const uint64_t block_size = Block::block_size;
 
     void build(compact_vector::builder const& from,
                compact_vector::builder const& pointers) {
-        uint64_t n = from.size();
-        m_size = n;
-        const static uint64_t block_size = Block::block_size;
-        uint64_t blocks = util::ceil_div(n, block_size);
-        std::cout << "blocks " << blocks << std::endl;
-        size_t begin_endpoints = sizeof(upperbound_type) * blocks;
-        size_t begin_data =
-            begin_endpoints + sizeof(endpoint_type) * (blocks - 1);
-        m_data.resize(begin_data);
-
-        std::vector<uint32_t> buf;
-        buf.reserve(block_size);
-        uint32_t last = -1;
+        uint64_t max = 0;
         auto from_it = from.begin();
-        auto pointers_it = pointers.begin();
-        uint64_t range_begin = *pointers_it;
-        ++pointers_it;
-        uint64_t range_end = *pointers_it;
-        uint64_t range_len = range_end - range_begin;
-        uint64_t within = 0;
-        uint32_t b = 0;
-        uint32_t curr_block_size =
-            (block_size <= n) ? block_size : (n % block_size);
-
-        for (uint64_t i = 0; i != n; ++i, ++from_it) {
-            if (within == range_len) {
-                within = 0;
-                range_begin = range_end;
-                ++pointers_it;
-                range_end = *pointers_it;
-                range_len = range_end - range_begin;
-                last =
-                    -1;  // first element of a range is always stored as it is
-            }
-
-            uint32_t v = *from_it;
-            buf.push_back(v - last - 1);
-            last = v;
-            ++within;
-
-            if (buf.size() == curr_block_size) {
-                *(reinterpret_cast<upperbound_type*>(
-                    &m_data[sizeof(upperbound_type) * b])) =
-                    last;                    // write upper bound
-                Block::encode(m_data, buf);  // write block
-
-                if (b != blocks - 1) {
-                    *(reinterpret_cast<endpoint_type*>(
-                        &m_data[begin_endpoints + sizeof(endpoint_type) * b])) =
-                        m_data.size() - begin_data;  // write endpoint
-                }
-
-                ++b;
-                curr_block_size =
-                    ((b + 1) * block_size <= n) ? block_size : (n % block_size);
-                buf.clear();
-            }
+        for (uint64_t i = 0; i != from.size(); ++i, ++from_it) {
+            max = std::max<uint64_t>(max, *from_it);
+        }
+        m_wide = max > std::numeric_limits<uint32_t>::max();
+        if (m_wide) {
+            encode<WideBlock>(from, pointers);
+        } else {
+            encode<Block>(from, pointers);
         }
     }
 
@@ -74,12 +34,15 @@ struct block_sequence {
 
         iterator(block_sequence const& seq, uint64_t pos = 0)
             : m_size(seq.size())
-            , m_blocks(util::ceil_div(m_size, Block::block_size))
+            , m_blocks(util::ceil_div(m_size, block_size))
+            , m_wide(seq.m_wide)
             , m_upperbounds(seq.m_data.data())
-            , m_endpoints(m_upperbounds + sizeof(upperbound_type) * m_blocks)
+            , m_endpoints(m_upperbounds +
+                          (m_wide ? sizeof(uint64_t) : sizeof(uint32_t)) *
+                              m_blocks)
             , m_data(m_endpoints + sizeof(endpoint_type) * (m_blocks - 1))
             , m_cur_block(-1) {
-            uint64_t block = pos / Block::block_size;
+            uint64_t block = pos / block_size;
             decode_block(block);
         }
 
@@ -125,15 +88,43 @@ struct block_sequence {
             }
         }
 
+        // Write the next n values to out, moving onto the last of them.
+        // begins[i] != 0 if the i-th value begins a range, whose first
+        // value is stored as it is instead of as a gap: the gaps of each
+        // block are prefix-summed without branching on it.
+        void next_values(uint64_t* out, uint64_t n, uint32_t const* begins) {
+            uint64_t i = 0;
+            while (i != n) {
+                if (m_pos_in_block + 1 == m_cur_block_size) {
+                    next();
+                    if (begins[i]) switch_range();
+                    out[i++] = m_val;
+                    continue;
+                }
+                uint64_t k = std::min<uint64_t>(
+                    n - i, m_cur_block_size - m_pos_in_block - 1);
+                uint64_t const* gaps = m_buffer + m_pos_in_block + 1;
+                uint64_t val = m_val;
+                for (uint64_t j = 0; j != k; ++j) {
+                    uint64_t keep = begins[i + j] ? 0 : uint64_t(-1);
+                    val = gaps[j] + ((val + 1) & keep);
+                    out[i + j] = val;
+                }
+                m_val = val;
+                m_pos_in_block += k;
+                i += k;
+            }
+        }
+
         inline uint64_t find(range const& r, uint64_t lower_bound) {
-            uint64_t block_begin = r.begin / Block::block_size;
-            uint64_t block_end = r.end / Block::block_size;
+            uint64_t block_begin = r.begin / block_size;
+            uint64_t block_end = (r.end - 1) / block_size;
 
             if (UNLIKELY(block_begin != m_cur_block)) {
                 decode_block(block_begin);
             }
 
-            uint64_t pos_in_block = r.begin % Block::block_size;
+            uint64_t pos_in_block = r.begin % block_size;
             switch_range(pos_in_block);
 
             if (UNLIKELY(block_begin != block_end and
@@ -148,15 +139,37 @@ struct block_sequence {
             }
 
             while (m_val < lower_bound) {
-                m_val += m_buffer[++m_pos_in_block] + 1;
-                assert(m_pos_in_block < m_cur_block_size);
+                if (position() + 1 == r.end) return global::not_found;
+                next();
+            }
+
+            return m_val == lower_bound ? position() : global::not_found;
+        }
+
+        // position of the first element >= lower_bound in
+        // [position(), r.end), or r.end
+        inline uint64_t next_geq(range const& r, uint64_t lower_bound) {
+            uint64_t block_end = (r.end - 1) / block_size;
+            if (UNLIKELY(m_cur_block != block_end and
+                         lower_bound > m_cur_upperbound)) {
+                uint64_t block = m_cur_block + 1;
+                while (block_upperbound(block) < lower_bound and
+                       block != block_end) {
+                    ++block;
+                }
+                decode_block(block);
+            }
+
+            while (m_val < lower_bound) {
+                if (position() + 1 == r.end) return r.end;
+                next();
             }
 
             return position();
         }
 
         uint64_t access(uint64_t pos) {
-            uint64_t block = pos / Block::block_size;
+            uint64_t block = pos / block_size;
             if (UNLIKELY(block != m_cur_block)) {
                 decode_block(block);
             }
@@ -173,16 +186,17 @@ struct block_sequence {
         }
 
         uint64_t position() const {
-            return m_cur_block * Block::block_size + m_pos_in_block;
+            return m_cur_block * block_size + m_pos_in_block;
         }
 
-        upperbound_type block_upperbound(uint32_t block) const {
-            return reinterpret_cast<upperbound_type const*>(
-                m_upperbounds)[block];
+        uint64_t block_upperbound(uint32_t block) const {
+            if (m_wide) {
+                return reinterpret_cast<uint64_t const*>(m_upperbounds)[block];
+            }
+            return reinterpret_cast<uint32_t const*>(m_upperbounds)[block];
         }
 
         void decode_block(uint64_t block) {
-            static const uint64_t block_size = Block::block_size;
             endpoint_type endpoint =
                 block ? (reinterpret_cast<endpoint_type const*>(
                             m_endpoints))[block - 1]
@@ -194,18 +208,27 @@ struct block_sequence {
                                    ? block_size
                                    : (m_size % block_size);
 
-            Block::decode(block_data, &(m_buffer[0]), m_cur_block_size);
+            if (m_wide) {
+                WideBlock::decode(block_data, m_buffer, m_cur_block_size);
+            } else {
+                uint32_t buffer[block_size];
+                Block::decode(block_data, buffer, m_cur_block_size);
+                for (uint64_t i = 0; i != m_cur_block_size; ++i) {
+                    m_buffer[i] = buffer[i];
+                }
+            }
 
             m_cur_upperbound = block_upperbound(block);
             m_cur_block = block;
             m_pos_in_block = 0;
-            uint32_t prev = block ? block_upperbound(block - 1) : uint32_t(-1);
+            uint64_t prev = block ? block_upperbound(block - 1) : uint64_t(-1);
             m_val = m_buffer[0] + prev + 1;
         }
 
     private:
         uint64_t m_size;
         uint64_t m_blocks;
+        bool m_wide;
         uint8_t const* m_upperbounds;
         uint8_t const* m_endpoints;
         uint8_t const* m_data;
@@ -213,10 +236,10 @@ struct block_sequence {
         uint32_t m_cur_block;
         uint32_t m_pos_in_block;
         uint32_t m_cur_block_size;
-        uint32_t m_cur_upperbound;
+        uint64_t m_cur_upperbound;
 
-        uint32_t m_val;
-        uint32_t m_buffer[Block::block_size];
+        uint64_t m_val;
+        uint64_t m_buffer[block_size];
     };
 
     uint64_t size() const {
@@ -234,21 +257,19 @@ struct block_sequence {
     iterator at(range const& r, uint64_t pos) const {
         assert(pos >= r.begin);
         iterator it(*this, r.begin);
-        uint64_t pos_in_block = r.begin % Block::block_size;
+        uint64_t pos_in_block = r.begin % block_size;
         it.switch_range(pos_in_block);
         it.access(pos);
         return it;
     }
 
-    inline uint64_t access(range const& r, uint64_t pos) {
-        uint64_t block = r.begin / Block::block_size;
-        uint64_t pos_in_block = r.begin % Block::block_size;
-        m_it.decode_block(block);
-        m_it.switch_range(pos_in_block);
-        return m_it.access(pos);
+    inline uint64_t access(range const& r, uint64_t pos) const {
+        iterator it(*this, r.begin);
+        it.switch_range(r.begin % block_size);
+        return it.access(pos);
     }
 
-    uint64_t find(range const& r, uint64_t id) {
+    uint64_t find(range const& r, uint64_t id) const {
         assert(r.end > r.begin);
         assert(r.end <= size());
 
@@ -261,27 +282,99 @@ struct block_sequence {
             }
         }
 
-        return m_it.find(r, id);
+        iterator it(*this, r.begin);
+        return it.find(r, id);
+    }
+
+    // position of the first element >= id in [pos, r.end), or r.end
+    uint64_t next_geq(range const& r, uint64_t pos, uint64_t id) const {
+        assert(r.begin <= pos and pos <= r.end);
+        if (pos == r.end) return r.end;
+        auto it = at(r, pos);
+        return it.next_geq(r, id);
     }
 
     size_t bytes() const {
-        return sizeof(m_size) + essentials::vec_bytes(m_data);
+        return sizeof(m_size) + sizeof(m_wide) + m_data.bytes();
     }
 
     template <typename Visitor>
     void visit(Visitor& visitor) {
         visitor.visit(m_size);
+        visitor.visit(m_wide);
         visitor.visit(m_data);
-
-        if (m_size) {
-            m_it = begin();
-        }
     }
 
 private:
     uint64_t m_size;
-    std::vector<uint8_t> m_data;
-    iterator m_it;
+    bool m_wide;
+    mappable_vector<uint8_t> m_data;
+
+    template <typename B>
+    void encode(compact_vector::builder const& from,
+                compact_vector::builder const& pointers) {
+        typedef typename B::value_type value_type;
+        typedef value_type upperbound_type;
+        uint64_t n = from.size();
+        m_size = n;
+        uint64_t blocks = util::ceil_div(n, block_size);
+        std::cout << "blocks " << blocks << std::endl;
+        size_t begin_endpoints = sizeof(upperbound_type) * blocks;
+        size_t begin_data =
+            begin_endpoints + sizeof(endpoint_type) * (blocks - 1);
+        std::vector<uint8_t> data(begin_data);
+
+        std::vector<value_type> buf;
+        buf.reserve(block_size);
+        value_type last = -1;
+        auto from_it = from.begin();
+        auto pointers_it = pointers.begin();
+        uint64_t range_begin = *pointers_it;
+        ++pointers_it;
+        uint64_t range_end = *pointers_it;
+        uint64_t range_len = range_end - range_begin;
+        uint64_t within = 0;
+        uint32_t b = 0;
+        uint32_t curr_block_size =
+            (block_size <= n) ? block_size : (n % block_size);
+
+        for (uint64_t i = 0; i != n; ++i, ++from_it) {
+            if (within == range_len) {
+                within = 0;
+                range_begin = range_end;
+                ++pointers_it;
+                range_end = *pointers_it;
+                range_len = range_end - range_begin;
+                last =
+                    -1;  // first element of a range is always stored as it is
+            }
+
+            value_type v = *from_it;
+            buf.push_back(v - last - 1);
+            last = v;
+            ++within;
+
+            if (buf.size() == curr_block_size) {
+                *(reinterpret_cast<upperbound_type*>(
+                    &data[sizeof(upperbound_type) * b])) =
+                    last;                    // write upper bound
+                B::encode(data, buf);        // write block
+
+                if (b != blocks - 1) {
+                    *(reinterpret_cast<endpoint_type*>(
+                        &data[begin_endpoints + sizeof(endpoint_type) * b])) =
+                        data.size() - begin_data;  // write endpoint
+                }
+
+                ++b;
+                curr_block_size =
+                    ((b + 1) * block_size <= n) ? block_size : (n % block_size);
+                buf.clear();
+            }
+        }
+        m_data.steal(data);
+    }
+
 };
 
 }  // namespace rdf
\ No newline at end of file
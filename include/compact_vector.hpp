@@ -1,9 +1,211 @@
 #pragma once
 
+#include <immintrin.h>
+
+#include <utility>
+
+#include "mappable_vector.hpp"
 #include "util.hpp"
 
 namespace rdf {
 
+// Kernels over the values of a compact_vector specialized on their width W,
+// so that all shifts and masks are constants. A compact_vector picks the
+// kernels for its width when it is built or loaded.
+namespace fixed_width {
+
+template <uint64_t W>
+struct view {
+    static const uint64_t mask =
+        W == 64 ? uint64_t(-1) : (uint64_t(1) << W) - 1;
+
+    struct iterator {
+        uint64_t operator*() const {
+            return v.access(i);
+        }
+
+        void operator++() {
+            ++i;
+        }
+
+        view v;
+        uint64_t i;
+    };
+
+    // as compact_vector::access(): a single unaligned load if W <= 57
+    inline uint64_t access(uint64_t i) const {
+        uint64_t pos = i * W;
+        if (W > 57) return operator[](i);
+        const char* ptr = reinterpret_cast<const char*>(bits);
+        return (*(reinterpret_cast<uint64_t const*>(ptr + (pos >> 3))) >>
+                (pos & 7)) &
+               mask;
+    }
+
+    // as compact_vector::operator[], never reading past the data
+    inline uint64_t operator[](uint64_t i) const {
+        uint64_t pos = i * W;
+        uint64_t block = pos >> 6;
+        uint64_t shift = pos & 63;
+        return shift + W <= 64 ? bits[block] >> shift & mask
+                               : (bits[block] >> shift) |
+                                     (bits[block + 1] << (64 - shift) & mask);
+    }
+
+    iterator at(uint64_t i) const {
+        return {*this, i};
+    }
+
+    uint64_t const* bits;
+};
+
+// unpack the 64 values packed in the W words from in
+template <uint64_t W>
+inline void unpack64(uint64_t const* in, uint64_t* out) {
+#pragma GCC unroll 64
+    for (uint64_t j = 0; j != 64; ++j) {
+        uint64_t pos = j * W;
+        uint64_t block = pos >> 6;
+        uint64_t shift = pos & 63;
+        uint64_t val = in[block] >> shift;
+        if (shift + W > 64) val |= in[block + 1] << (64 - shift);
+        out[j] = val & view<W>::mask;
+    }
+}
+
+// as the generic linear_search(), comparing 8 values at a time with
+// AVX-512 if they can be gathered as in access(). Fewer than 3 values are
+// faster to compare one by one.
+template <uint64_t W>
+inline uint64_t linear_search(view<W> const& v, uint64_t id, uint64_t lo,
+                              uint64_t hi) {
+#if defined(__AVX512F__)
+    if (W <= 57 and hi - lo >= 2) {
+        const char* ptr = reinterpret_cast<const char*>(v.bits);
+        __m512i mask = _mm512_set1_epi64(view<W>::mask);
+        __m512i lanes = _mm512_set_epi64(7 * W, 6 * W, 5 * W, 4 * W, 3 * W,
+                                         2 * W, W, 0);
+        __m512i ids = _mm512_set1_epi64(id);
+        for (uint64_t pos = lo; pos <= hi; pos += 8) {
+            uint64_t n = std::min<uint64_t>(hi - pos + 1, 8);
+            __mmask8 active = (1U << n) - 1;
+            __m512i bit_pos =
+                _mm512_add_epi64(_mm512_set1_epi64(pos * W), lanes);
+            // lanes past hi are not loaded
+            __m512i words = _mm512_mask_i64gather_epi64(
+                _mm512_setzero_si512(), active,
+                _mm512_maskz_srli_epi64(active, bit_pos, 3), ptr, 1);
+            __m512i shifts = _mm512_and_si512(bit_pos, _mm512_set1_epi64(7));
+            // zero-masked, as in decode()
+            __m512i values = _mm512_and_si512(
+                _mm512_maskz_srlv_epi64(active, words, shifts), mask);
+            __mmask8 equal = _mm512_mask_cmpeq_epu64_mask(active, values, ids);
+            if (equal) return pos + __builtin_ctz(equal);
+        }
+        return global::not_found;
+    }
+#endif
+    for (uint64_t pos = lo; pos <= hi; ++pos) {
+        if (v.access(pos) == id) return pos;
+    }
+    return global::not_found;
+}
+
+template <uint64_t W>
+uint64_t find(uint64_t const* bits, uint64_t id, uint64_t lo, uint64_t hi,
+              uint8_t search) {
+    return search::find(view<W>{bits}, id, lo, hi, search);
+}
+
+template <uint64_t W>
+uint64_t next_geq(uint64_t const* bits, uint64_t id, uint64_t lo,
+                  uint64_t hi) {
+    return next_geq_search(view<W>{bits}, id, lo, hi);
+}
+
+// Decode the n values from position begin to out, given the number of words
+// of the data. With AVX-512 or AVX2, values of up to 57 bits are extracted
+// 8 or 4 at a time, gathering each with an unaligned load as in access().
+// Otherwise, and for wider values, the groups of 64 values starting at a
+// word are unpacked by a fully unrolled loop.
+template <uint64_t W>
+void decode(uint64_t const* bits, uint64_t words, uint64_t begin, uint64_t n,
+            uint64_t* out) {
+    view<W> v{bits};
+    uint64_t i = 0;
+#if defined(__AVX512F__) or defined(__AVX2__)
+    if (W <= 57 and words) {
+        // positions whose 8 bytes can be loaded within the data
+        uint64_t end = ((words * 8 - 8) * 8 + 7) / W + 1;
+        end = end > begin ? std::min(end - begin, n) : 0;
+        const char* ptr = reinterpret_cast<const char*>(bits);
+#if defined(__AVX512F__)
+        __m512i mask = _mm512_set1_epi64(view<W>::mask);
+        __m512i lanes = _mm512_set_epi64(7 * W, 6 * W, 5 * W, 4 * W, 3 * W,
+                                         2 * W, W, 0);
+        for (; i + 8 <= end; i += 8) {
+            __m512i pos =
+                _mm512_add_epi64(_mm512_set1_epi64((begin + i) * W), lanes);
+            // the zero-masked forms, as GCC warns that the source of the
+            // unmasked ones may be used uninitialized
+            __m512i words = _mm512_mask_i64gather_epi64(
+                _mm512_setzero_si512(), 0xFF,
+                _mm512_maskz_srli_epi64(0xFF, pos, 3), ptr, 1);
+            __m512i shifts = _mm512_and_si512(pos, _mm512_set1_epi64(7));
+            _mm512_storeu_si512(
+                out + i,
+                _mm512_and_si512(_mm512_maskz_srlv_epi64(0xFF, words, shifts),
+                                 mask));
+        }
+#else
+        __m256i mask = _mm256_set1_epi64x(view<W>::mask);
+        __m256i lanes = _mm256_set_epi64x(3 * W, 2 * W, W, 0);
+        for (; i + 4 <= end; i += 4) {
+            __m256i pos =
+                _mm256_add_epi64(_mm256_set1_epi64x((begin + i) * W), lanes);
+            __m256i words = _mm256_i64gather_epi64(
+                reinterpret_cast<long long const*>(ptr),
+                _mm256_srli_epi64(pos, 3), 1);
+            __m256i shifts = _mm256_and_si256(pos, _mm256_set1_epi64x(7));
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i*>(out + i),
+                _mm256_and_si256(_mm256_srlv_epi64(words, shifts), mask));
+        }
+#endif
+        for (; i != n; ++i) out[i] = v[begin + i];
+        return;
+    }
+#endif
+    (void)words;
+    for (; i != n and (begin + i) % 64; ++i) out[i] = v[begin + i];
+    for (; i + 64 <= n; i += 64) {
+        unpack64<W>(bits + (begin + i) / 64 * W, out + i);
+    }
+    for (; i != n; ++i) out[i] = v[begin + i];
+}
+
+struct kernels {
+    uint64_t (*find)(uint64_t const*, uint64_t, uint64_t, uint64_t, uint8_t);
+    uint64_t (*next_geq)(uint64_t const*, uint64_t, uint64_t, uint64_t);
+    void (*decode)(uint64_t const*, uint64_t, uint64_t, uint64_t, uint64_t*);
+};
+
+template <uint64_t... I>
+inline kernels const* make_table(std::integer_sequence<uint64_t, I...>) {
+    static const kernels table[] = {
+        {&find<I + 1>, &next_geq<I + 1>, &decode<I + 1>}...};
+    return table;
+}
+
+// the kernels for values of 1 to 64 bits
+inline kernels const* kernels_for(uint64_t width) {
+    assert(width >= 1 and width <= 64);
+    static kernels const* table =
+        make_table(std::make_integer_sequence<uint64_t, 64>());
+    return table + width - 1;
+}
+}  // namespace fixed_width
+
 struct compact_vector {
     template <typename Data>
     struct enumerator {
@@ -39,6 +241,28 @@ struct compact_vector {
             return;
         }
 
+        // Write the next n values to out, moving onto the last of them.
+        // The values are stored as they are, so where ranges begin does not
+        // matter.
+        void next_values(uint64_t* out, uint64_t n,
+                         uint32_t const* /* begins */) {
+            m_data->decode(m_i + 1, n, out);
+            m_i += n;
+            m_cur_val = out[n - 1];
+            uint64_t pos = (m_i + 1) * m_data->m_width;
+            m_cur_block = pos >> 6;
+            m_cur_shift = pos & 63;
+        }
+
+        // Move to the first value >= lower_bound in [position, r.end) and
+        // return its position. If there is none, move to r.end - 1 and
+        // return r.end.
+        uint64_t next_geq(range const& r, uint64_t lower_bound) {
+            uint64_t pos = m_data->next_geq(r, m_i, lower_bound);
+            *this = enumerator(m_data, pos == r.end ? r.end - 1 : pos);
+            return pos;
+        }
+
         bool operator==(enumerator const& other) const {
             return m_i == other.m_i;
         }
@@ -177,7 +401,8 @@ struct compact_vector {
             cv.m_size = m_size;
             cv.m_width = m_width;
             cv.m_mask = m_mask;
-            cv.m_bits.swap(m_bits);
+            cv.m_bits.steal(m_bits);
+            cv.m_kernels = fixed_width::kernels_for(m_width);
             builder().swap(*this);
         }
 
@@ -216,11 +441,17 @@ struct compact_vector {
         std::vector<uint64_t> m_bits;
     };
 
-    compact_vector() : m_size(0), m_width(0), m_mask(0) {}
+    compact_vector()
+        : m_size(0)
+        , m_width(0)
+        , m_mask(0)
+        , m_search(search::binary)
+        , m_kernels(nullptr) {}
 
     void build(compact_vector::builder& from,
-               compact_vector::builder const& /* pointers */) {
+               compact_vector::builder const& pointers) {
         from.build(*this);
+        m_search = search::choose(*this, pointers);
     }
 
     inline uint64_t operator[](uint64_t i) const {
@@ -244,10 +475,16 @@ struct compact_vector {
                m_mask;
     }
 
-    inline uint64_t access(range const& /* r */, uint64_t pos) {
+    inline uint64_t access(range const& /* r */, uint64_t pos) const {
         return access(pos);
     }
 
+    // Decode the n values from position begin to out.
+    void decode(uint64_t begin, uint64_t n, uint64_t* out) const {
+        assert(begin + n <= size());
+        m_kernels->decode(m_bits.data(), m_bits.size(), begin, n, out);
+    }
+
     inline void prefetch(size_t i) const {
         util::prefetch(m_bits.data() + i);
     }
@@ -264,6 +501,10 @@ struct compact_vector {
         return m_width;
     }
 
+    uint8_t search_type() const {
+        return m_search;
+    }
+
     typedef enumerator<compact_vector> iterator;
 
     iterator begin() const {
@@ -282,25 +523,34 @@ struct compact_vector {
         return at(pos);
     }
 
-    uint64_t find(range const& r, uint64_t id) {
+    uint64_t find(range const& r, uint64_t id) const {
         assert(r.end > r.begin);
         assert(r.end <= size());
-        return scan_binary_search(*this, id, r.begin, r.end - 1);
+        return m_kernels->find(m_bits.data(), id, r.begin, r.end - 1,
+                               m_search);
+    }
+
+    // position of the first element >= id in [pos, r.end), or r.end
+    uint64_t next_geq(range const& r, uint64_t pos, uint64_t id) const {
+        assert(r.begin <= pos and pos <= r.end);
+        return m_kernels->next_geq(m_bits.data(), id, pos, r.end);
     }
 
-    std::vector<uint64_t> const& bits() const {
+    mappable_vector<uint64_t> const& bits() const {
         return m_bits;
     }
 
     size_t bytes() const {
         return sizeof(m_size) + sizeof(m_width) + sizeof(m_mask) +
-               essentials::vec_bytes(m_bits);
+               sizeof(m_search) + m_bits.bytes();
     }
 
     void swap(compact_vector& other) {
         std::swap(m_size, other.m_size);
         std::swap(m_width, other.m_width);
         std::swap(m_mask, other.m_mask);
+        std::swap(m_search, other.m_search);
+        std::swap(m_kernels, other.m_kernels);
         m_bits.swap(other.m_bits);
     }
 
@@ -309,13 +559,17 @@ struct compact_vector {
         visitor.visit(m_size);
         visitor.visit(m_width);
         visitor.visit(m_mask);
+        visitor.visit(m_search);
         visitor.visit(m_bits);
+        if (m_width) m_kernels = fixed_width::kernels_for(m_width);
     }
 
 private:
     uint64_t m_size;
     uint64_t m_width;
     uint64_t m_mask;
-    std::vector<uint64_t> m_bits;
+    uint8_t m_search;  // the search::type of find
+    fixed_width::kernels const* m_kernels;  // not stored
+    mappable_vector<uint64_t> m_bits;
 };
 }  // namespace rdf
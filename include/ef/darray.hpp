@@ -12,7 +12,7 @@ struct darray {
     darray() : m_positions() {}
 
     darray(bit_vector const& bv) : m_positions() {
-        std::vector<uint64_t> const& data = bv.data();
+        auto const& data = bv.data();
         std::vector<uint64_t> cur_block_positions;
         std::vector<int64_t> block_inventory;
         std::vector<uint16_t> subblock_inventory;
@@ -45,9 +45,9 @@ struct darray {
             flush_cur_block(cur_block_positions, block_inventory,
                             subblock_inventory, overflow_positions);
         }
-        m_block_inventory.swap(block_inventory);
-        m_subblock_inventory.swap(subblock_inventory);
-        m_overflow_positions.swap(overflow_positions);
+        m_block_inventory.steal(block_inventory);
+        m_subblock_inventory.steal(subblock_inventory);
+        m_overflow_positions.steal(overflow_positions);
     }
 
     void swap(darray& other) {
@@ -70,7 +70,7 @@ struct darray {
         size_t subblock = idx / subblock_size;
         size_t start_pos = uint64_t(block_pos) + m_subblock_inventory[subblock];
         size_t reminder = idx & (subblock_size - 1);
-        std::vector<uint64_t> const& data = bv.data();
+        auto const& data = bv.data();
 
         if (!reminder) {
             return start_pos;
@@ -92,14 +92,19 @@ struct darray {
         }
     }
 
+    inline void prefetch(uint64_t idx) const {
+        util::prefetch(m_block_inventory.data() + idx / block_size);
+        util::prefetch(m_subblock_inventory.data() + idx / subblock_size);
+    }
+
     inline uint64_t num_positions() const {
         return m_positions;
     }
 
     uint64_t bytes() const {
-        return sizeof(m_positions) + essentials::vec_bytes(m_block_inventory) +
-               essentials::vec_bytes(m_subblock_inventory) +
-               essentials::vec_bytes(m_overflow_positions);
+        return sizeof(m_positions) + m_block_inventory.bytes() +
+               m_subblock_inventory.bytes() +
+               m_overflow_positions.bytes();
     }
 
     template <typename Visitor>
@@ -141,19 +146,21 @@ protected:
     static const size_t max_in_block_distance = 1 << 16;
 
     size_t m_positions;
-    std::vector<int64_t> m_block_inventory;
-    std::vector<uint16_t> m_subblock_inventory;
-    std::vector<uint64_t> m_overflow_positions;
+    mappable_vector<int64_t> m_block_inventory;
+    mappable_vector<uint16_t> m_subblock_inventory;
+    mappable_vector<uint64_t> m_overflow_positions;
 };
 
 struct identity_getter {
-    uint64_t operator()(std::vector<uint64_t> const& data, size_t idx) const {
+    uint64_t operator()(mappable_vector<uint64_t> const& data,
+                        size_t idx) const {
         return data[idx];
     }
 };
 
 struct negating_getter {
-    uint64_t operator()(std::vector<uint64_t> const& data, size_t idx) const {
+    uint64_t operator()(mappable_vector<uint64_t> const& data,
+                        size_t idx) const {
         return ~data[idx];
     }
 };
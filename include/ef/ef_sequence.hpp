@@ -8,7 +8,11 @@ namespace rdf {
 namespace ef {
 
 struct ef_sequence {
-    ef_sequence() : m_l(0), m_index_for_find(false), m_size(0) {}
+    ef_sequence()
+        : m_l(0)
+        , m_index_for_find(false)
+        , m_search(search::binary)
+        , m_size(0) {}
 
     void build(compact_vector::builder const& from, bool index_for_find) {
         build(from.begin(), from.size(), from.back(), index_for_find);
@@ -48,6 +52,7 @@ struct ef_sequence {
         }
         assert(values.size() == n);
         build(values.begin(), values.size(), values.back(), false);
+        m_search = search::choose(*this, pointers);
     }
 
     struct iterator {
@@ -108,6 +113,35 @@ struct ef_sequence {
             m_prev_range_upper_bound = m_last;
         }
 
+        // Write the next n values to out, moving onto the last of them.
+        // begins[i] != 0 if the i-th value begins a range: the upper bound
+        // of the previous range is then switched without branching.
+        void next_values(uint64_t* out, uint64_t n, uint32_t const* begins) {
+            uint64_t base = m_prev_range_upper_bound;
+            uint64_t last = m_last;
+            for (uint64_t i = 0; i != n; ++i) {
+                operator++();
+                uint64_t val = operator*();
+                base = begins[i] ? last : base;
+                last = val;
+                out[i] = val - base;
+            }
+            m_prev_range_upper_bound = base;
+            m_last = last;
+        }
+
+        // Move to the first value >= lower_bound in [position, r.end) and
+        // return its position. If there is none, move to r.end - 1 and
+        // return r.end.
+        uint64_t next_geq(range const& r, uint64_t lower_bound) {
+            uint64_t prev_upper = m_prev_range_upper_bound;
+            uint64_t pos = next_geq_search(*m_ef, lower_bound + prev_upper,
+                                           m_pos, r.end);
+            *this = iterator(*m_ef, {0, 0}, pos == r.end ? r.end - 1 : pos);
+            m_prev_range_upper_bound = prev_upper;
+            return pos;
+        }
+
         uint64_t operator*() {
             if (m_pos == m_ef->size()) {
                 return m_val;
@@ -158,10 +192,16 @@ struct ef_sequence {
                m_low_bits.get_bits(i * m_l, m_l);
     }
 
-    inline uint64_t access(range const& r, uint64_t pos) {
+    inline uint64_t access(range const& r, uint64_t pos) const {
         return access(pos) - previous_range_upperbound(r);
     }
 
+    // prefetch the data needed to access the i-th element
+    inline void prefetch(uint64_t i) const {
+        m_high_bits_d1.prefetch(i);
+        util::prefetch(m_low_bits.data().data() + ((i * m_l) >> 6));
+    }
+
     inline uint64_t num_ones() const {
         return m_high_bits_d1.num_positions();
     }
@@ -195,14 +235,22 @@ struct ef_sequence {
         return pos - (val != x);
     }
 
-    uint64_t find(range const& r, uint64_t id) {
+    uint64_t find(range const& r, uint64_t id) const {
         assert(r.end > r.begin);
         assert(r.end <= size());
         uint64_t prev_upper = previous_range_upperbound(r);
-        return scan_binary_search(*this, id + prev_upper, r.begin, r.end - 1);
+        return search::find(*this, id + prev_upper, r.begin, r.end - 1,
+                            m_search);
+    }
+
+    // position of the first element >= id in [pos, r.end), or r.end
+    uint64_t next_geq(range const& r, uint64_t pos, uint64_t id) const {
+        assert(r.begin <= pos and pos <= r.end);
+        uint64_t prev_upper = previous_range_upperbound(r);
+        return next_geq_search(*this, id + prev_upper, pos, r.end);
     }
 
-    inline range operator[](uint64_t i) {
+    inline range operator[](uint64_t i) const {
         return {access(i), access(i + 1)};
     }
 
@@ -210,6 +258,10 @@ struct ef_sequence {
         return m_size;
     }
 
+    uint8_t search_type() const {
+        return m_search;
+    }
+
     inline uint64_t universe() const {
         return access(m_size - 1);
     }
@@ -231,8 +283,8 @@ struct ef_sequence {
     }
 
     uint64_t bytes() const {
-        return sizeof(m_l) + sizeof(m_index_for_find) + m_high_bits.bytes() +
-               m_high_bits_d1.bytes() +
+        return sizeof(m_l) + sizeof(m_index_for_find) + sizeof(m_search) +
+               m_high_bits.bytes() + m_high_bits_d1.bytes() +
                (m_index_for_find ? m_high_bits_d0.bytes() : 0) +
                m_low_bits.bytes() + sizeof(m_size);
     }
@@ -240,6 +292,7 @@ struct ef_sequence {
     void swap(ef_sequence& other) {
         std::swap(other.m_size, m_size);
         std::swap(other.m_index_for_find, m_index_for_find);
+        std::swap(other.m_search, m_search);
         other.m_high_bits.swap(m_high_bits);
         other.m_high_bits_d1.swap(m_high_bits_d1);
         other.m_high_bits_d0.swap(m_high_bits_d0);
@@ -251,6 +304,7 @@ struct ef_sequence {
     void visit(Visitor& visitor) {
         visitor.visit(m_l);
         visitor.visit(m_index_for_find);
+        visitor.visit(m_search);
         visitor.visit(m_high_bits);
         visitor.visit(m_high_bits_d1);
 
@@ -265,6 +319,7 @@ struct ef_sequence {
 private:
     uint8_t m_l;
     bool m_index_for_find;
+    uint8_t m_search;  // the search::type of find
     bit_vector m_high_bits;
     darray1 m_high_bits_d1;
     darray0 m_high_bits_d0;
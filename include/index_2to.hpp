@@ -1,7 +1,10 @@
 #pragma once
 
-#include "compact_vector.hpp"
+#include <future>
+
+#include "inverted_index.hpp"
 #include "parameters.hpp"
+#include "triplets_reader.hpp"
 #include "util_types.hpp"
 
 namespace rdf {
@@ -11,202 +14,33 @@ struct index_2to {
     typedef SPO spo_type;
     typedef OPS ops_type;
 
-    template <typename Nodes = typename SPO::levels_type::first::nodes_type,
-              typename Pointers =
-                  typename SPO::levels_type::first::pointers_type>
-    struct p_index {
-        struct builder {
-            builder() {}
-
-            builder(parameters const& params) {
-                uint64_t n = params.num_elements[3];  // (s,p) pairs
-                resize(pointers, params.predicates() + 1, n);
-                resize(nodes, n, params.subjects());
-            }
-
-            void build(p_index<Nodes, Pointers>& index,
-                       parameters const& params) {
-                // std::cout << "  num. predicates = " << params.predicates()
-                //           << std::endl;
-
-                std::vector<uint64_t> offsets(params.predicates() + 1, 0);
-                int perm = permutation_type::spo;
-                std::string filename(std::string(params.collection_basename) +
-                                     "." + suffix(perm));
-
-                // 1. scan the whole file to build the offsets (pointers)
-                {
-                    std::ifstream input(filename.c_str(), std::ios_base::in);
-                    triplets_iterator input_it(input, perm);
-
-                    triplet prev;
-                    while (input) {
-                        triplet curr = *input_it;
-                        if (curr.first != prev.first or
-                            curr.second != prev.second) {
-                            ++offsets[curr.second + 1];  // shifted by 1
-                        }
-                        prev = curr;
-                        ++input_it;
-                    }
-                    input.close();
-
-                    // transform the counts in offsets
-                    for (uint64_t i = 2; i < offsets.size(); ++i) {
-                        offsets[i] += offsets[i - 1];
-                    }
-
-                    std::cout << "  offsets.back() = " << offsets.back()
-                              << std::endl;
-                    std::cout << "  (s,p) pairs = " << params.num_elements[3]
-                              << std::endl;
-                    assert(offsets.back() == params.num_elements[3]);
-                    pointers.fill(offsets.begin(), offsets.size());
-                    index.pointers.build(pointers, false);
-                }
-
-                // 2. scan the whole file to build the sequence
-                {
-                    std::ifstream input(filename.c_str(), std::ios_base::in);
-                    triplets_iterator input_it(input, perm);
-
-                    triplet prev;
-                    while (input) {
-                        triplet curr = *input_it;
-                        if (curr.first != prev.first or
-                            curr.second != prev.second) {
-                            uint64_t& pos = offsets[curr.second];
-                            nodes.set(pos, curr.first);
-                            ++pos;
-                        }
-                        prev = curr;
-                        ++input_it;
-                    }
-                    input.close();
-                }
-
-                index.nodes.build(nodes, pointers);
-
-                std::cout << "  pointers take: "
-                          << index.pointers.bytes() * 8.0 / params.triplets()
-                          << " [bpt]" << std::endl;
-                std::cout << "  nodes take: "
-                          << index.nodes.bytes() * 8.0 / params.triplets()
-                          << " [bpt]" << std::endl;
-            }
-
-            compact_vector::builder pointers;
-            compact_vector::builder nodes;
-        };
-
-        struct iterator_p {
-            iterator_p(uint64_t second, p_index<Nodes, Pointers>* data,
-                       SPO* spo)
-                : m_i(0), m_j(0), m_objects(0), m_spo(spo) {
-                // permute (s,p,o) in (p,s,o)
-                m_val.first = second;
-                m_val.second = 0;
-                m_val.third = 0;
-
-                auto r = (data->pointers)[second];
-                m_subjects = r.end - r.begin;
-                m_subjects_it = typename SPO::levels_type::first::iterator(
-                    (data->nodes).at(r, r.begin), (data->pointers).at(second));
-            }
-
-            bool has_next() {
-                while (m_j < m_objects) {
-                    return true;
-                }
-
-                while (m_i < m_subjects) {
-                    uint64_t s = *m_subjects_it;
-                    auto r = (m_spo->first).pointers[s];
-                    uint64_t pos = (m_spo->second).nodes.find(r, m_val.first);
-                    assert(pos != global::not_found);
-
-                    m_val.second = s;
-                    r = (m_spo->second).pointers[pos];
-                    m_j = 0;
-                    m_objects = r.end - r.begin;
-                    m_objects_it = typename SPO::levels_type::third::iterator(
-                        (m_spo->third).nodes.at(r, r.begin),
-                        (m_spo->second).pointers.at(pos));
-
-                    ++m_subjects_it;
-                    ++m_i;
-
-                    return true;
-                }
-
-                return false;
-            }
-
-            void operator++() {
-                ++m_j;
-                ++m_objects_it;
-            }
-
-            triplet operator*() {
-                m_val.third = *m_objects_it;
-                return m_val;
-            }
-
-        private:
-            triplet m_val;
-            uint64_t m_i;
-            uint64_t m_j;
-            uint64_t m_subjects;
-            uint64_t m_objects;
-            SPO* m_spo;
-            typename SPO::levels_type::third::iterator m_objects_it;
-            typename SPO::levels_type::first::iterator m_subjects_it;
-        };
-
-        iterator_p select_p(triplet const& t, SPO* spo) {
-            assert(t.first == global::wildcard_symbol);
-            assert(t.second != global::wildcard_symbol);
-            assert(t.third == global::wildcard_symbol);
-            return iterator_p(t.second, this, spo);
-        }
-
-        size_t bytes() const {
-            return pointers.bytes() + nodes.bytes();
-        }
-
-        template <typename Visitor>
-        void visit(Visitor& visitor) {
-            visitor.visit(pointers);
-            visitor.visit(nodes);
-        }
-
-        Pointers pointers;
-        Nodes nodes;
-    };
+    // the subjects of every predicate
+    typedef inverted_index<SPO> p_index;
 
     struct builder {
         builder(parameters const& params)
             : m_params(params)
             , m_spo(permutation_type::spo, params)
             , m_ops(permutation_type::ops, params)
-            , m_p_index(params) {}
+            , m_p_index(params.predicates(), params.num_elements[3],
+                        params.subjects()) {}
 
+        // The two tries are built concurrently; the index on predicates
+        // only needs SPO, so it is built by the same task right after it.
         void build(index_2to<SPO, OPS>& index) {
-            util::logger("building first and second levels...");
-            m_spo.build_first_and_second_level(index.m_spo, m_params);
-            util::logger("SPO DONE");
-            m_ops.build_first_and_second_level(index.m_ops, m_params);
-            util::logger("OPS DONE");
-
-            util::logger("building third levels...");
-            m_spo.build_third_level(index.m_spo, m_params);
-            util::logger("SPO DONE");
-            m_ops.build_third_level(index.m_ops, m_params);
-            util::logger("OPS DONE");
-
-            util::logger("building index on predicates...");
-            m_p_index.build(index.m_p_index, m_params);
-            util::logger("DONE");
+            util::logger("building tries...");
+            auto spo = std::async(std::launch::async, [&]() {
+                m_spo.build(index.m_spo, m_params);
+                util::logger("SPO DONE");
+                m_p_index.build(index.m_p_index, index.m_spo);
+                util::logger("index on predicates DONE");
+            });
+            auto ops = std::async(std::launch::async, [&]() {
+                m_ops.build(index.m_ops, m_params);
+                util::logger("OPS DONE");
+            });
+            spo.get();
+            ops.get();
         }
 
     private:
@@ -214,14 +48,17 @@ struct index_2to {
         typename SPO::builder m_spo;
         typename OPS::builder m_ops;
 
-        typename p_index<>::builder m_p_index;
+        typename p_index::builder m_p_index;
     };
 
     struct iterator {
-        iterator(index_2to& index)
-            : m_perm(permutation_type::spo), m_spo(index.m_spo.select_all()) {}
+        iterator(index_2to const& index)
+            : m_perm(permutation_type::spo)
+            , m_by_object(false)
+            , m_spo(index.m_spo.select_all()) {}
 
-        iterator(triplet const& t, index_2to& index) {
+        iterator(triplet const& t, index_2to const& index)
+            : m_by_object(false) {
             triplet permuted;
             m_perm = index_2to::permute(t, permuted);
             switch (m_perm) {
@@ -232,11 +69,17 @@ struct index_2to {
                     m_ops = index.m_ops.select(permuted);
                     break;
                 case permutation_type::osp:
-                    m_osp = index.m_spo.select_so(permuted);
+                    m_by_object = index.so_by_object(permuted);
+                    if (m_by_object) {
+                        m_osp_ops = index.m_ops.select_so(
+                            index_2to::permute_so(permuted));
+                    } else {
+                        m_osp = index.m_spo.select_so(permuted);
+                    }
                     break;
                 case permutation_type::pos:
-                    // m_pos = index.m_spo.select_p(permuted);
-                    m_pos = index.m_p_index.select_p(permuted, &(index.m_spo));
+                    m_pos = index.m_p_index.select(permuted.second,
+                                                   &(index.m_spo));
                     break;
                 default:
                     assert(false);
@@ -251,7 +94,8 @@ struct index_2to {
             case permutation_type::ops:                        \
                 return m_ops.METHOD ACTUALS;                   \
             case permutation_type::osp:                        \
-                return m_osp.METHOD ACTUALS;                   \
+                return m_by_object ? m_osp_ops.METHOD ACTUALS  \
+                                   : m_osp.METHOD ACTUALS;     \
             case permutation_type::pos:                        \
                 return m_pos.METHOD ACTUALS;                   \
             default:                                           \
@@ -264,32 +108,144 @@ struct index_2to {
         ITERATOR_METHOD(bool, has_next, (), ());
         ITERATOR_METHOD(void, operator++,(), ());
         ITERATOR_METHOD(triplet, operator*,(), ());
+        ITERATOR_METHOD(uint64_t, next_batch, (triplet* out, uint64_t n),
+                        (out, n));
 
 #undef ITERATOR_METHOD
 
     private:
         int m_perm;
+        bool m_by_object;
         union {
             typename SPO::iterator m_spo;
             typename SPO::iterator_so m_osp;
+            typename OPS::iterator_so m_osp_ops;
             typename OPS::iterator m_ops;
-            typename p_index<>::iterator_p m_pos;
-            // typename SPO::iterator_po m_pos;
+            typename p_index::iterator m_pos;
         };
     };
 
-    iterator select(triplet const& t) {
+    iterator select(triplet const& t) const {
         return iterator(t, *this);
     }
 
-    iterator select_all() {
+    // A seekable iterator over the trie of one of the permutations
+    // (see trie::cursor).
+    struct cursor {
+        cursor(int perm, index_2to const& index) : m_perm(perm) {
+            switch (m_perm) {
+                case permutation_type::spo:
+                    m_spo = index.m_spo.open_cursor();
+                    break;
+                case permutation_type::ops:
+                    m_ops = index.m_ops.open_cursor();
+                    break;
+                default:
+                    assert(false);
+            }
+        }
+
+#define CURSOR_METHOD(RETURN_TYPE, METHOD, FORMALS, ACTUALS)   \
+    RETURN_TYPE METHOD FORMALS {                               \
+        switch (m_perm) {                                      \
+            case permutation_type::spo:                        \
+                return m_spo.METHOD ACTUALS;                   \
+            case permutation_type::ops:                        \
+                return m_ops.METHOD ACTUALS;                   \
+            default:                                           \
+                assert(false);                                 \
+                __builtin_unreachable();                       \
+        }                                                      \
+    }                                                          \
+    /**/
+
+        CURSOR_METHOD(uint32_t, depth, (), ());
+        CURSOR_METHOD(void, open, (), ());
+        CURSOR_METHOD(void, up, (), ());
+        CURSOR_METHOD(bool, at_end, (), ());
+        CURSOR_METHOD(uint64_t, key, (), ());
+        CURSOR_METHOD(void, next, (), ());
+        CURSOR_METHOD(void, seek, (uint64_t k), (k));
+
+#undef CURSOR_METHOD
+
+    private:
+        int m_perm;
+        union {
+            typename SPO::cursor m_spo;
+            typename OPS::cursor m_ops;
+        };
+    };
+
+    // the permutations that are stored as tries
+    static std::vector<int> permutations() {
+        return {permutation_type::spo, permutation_type::ops};
+    }
+
+    cursor open_cursor(int perm) const {
+        return cursor(perm, *this);
+    }
+
+    iterator select_all() const {
         return iterator(*this);
     }
 
-    uint64_t is_member(triplet const& t) {
+    uint64_t is_member(triplet const& t) const {
         return m_spo.is_member(t);
     }
 
+    void is_member(triplet const* queries, uint64_t n, uint64_t* out) const {
+        m_spo.is_member(queries, n, out);
+    }
+
+    // whether (s,?,o) searches s under the predicates of o in OPS, one
+    // search each, rather than o under those of s in SPO
+    bool so_by_object(triplet const& t) const {
+        return rdf::so_by_object(
+            m_spo.children(t.first),
+            [&]() { return m_ops.children(t.third); }, 1);
+    }
+
+    // number of triples matching t: (s,?,o) probes the third level of SPO
+    // or OPS (see so_by_object); (?,p,?) sums the sizes of the ranges of the
+    // subjects of p, without accessing the third level
+    uint64_t count(triplet const& t) const {
+        if (num_wildcards(t) == 3) return triplets();
+        triplet permuted;
+        switch (index_2to::permute(t, permuted)) {
+            case permutation_type::spo:
+                return m_spo.count(permuted);
+            case permutation_type::ops:
+                return m_ops.count(permuted);
+            case permutation_type::osp:
+                return so_by_object(permuted)
+                           ? m_ops.count_so(index_2to::permute_so(permuted))
+                           : m_spo.count_so(permuted);
+            case permutation_type::pos:
+                return m_p_index.count(permuted.second, &m_spo);
+            default:
+                assert(false);
+                __builtin_unreachable();
+        }
+    }
+
+    // an upper bound to count(t), that never accesses a third level
+    uint64_t count_upper_bound(triplet const& t) const {
+        if (num_wildcards(t) == 0) {
+            triplet sp = t;
+            sp.third = global::wildcard_symbol;
+            return std::min<uint64_t>(count(sp), 1);
+        }
+        if (num_wildcards(t) == 1 and t.second == global::wildcard_symbol) {
+            triplet s = t;
+            triplet o = t;
+            s.third = global::wildcard_symbol;
+            o.first = global::wildcard_symbol;
+            return std::min(count(s), count(o));
+        }
+        return count(t);
+    }
+
     void print_stats(essentials::json_lines& stats);
 
     uint64_t triplets() const {
@@ -320,6 +276,14 @@ struct index_2to {
         visitor.visit(m_p_index);
     }
 
+    // the permutation in which select(t) returns the triples: (?,p,?) is
+    // answered in (p,s,o) order by p_index
+    static int select_permutation(triplet const& t) {
+        triplet permuted;
+        int perm = index_2to::permute(t, permuted);
+        return perm == permutation_type::pos ? permutation_type::pso : perm;
+    }
+
     static int permute(triplet const& t, triplet& permuted) {
         if (t.first != global::wildcard_symbol) {
             permuted = t;
@@ -341,9 +305,16 @@ struct index_2to {
         return permutation_type::ops;
     }
 
+    // (s,?,o) as searched in OPS
+    static triplet permute_so(triplet const& t) {
+        triplet permuted = t;
+        std::swap(permuted.first, permuted.third);
+        return permuted;
+    }
+
 private:
     SPO m_spo;
     OPS m_ops;
-    p_index<> m_p_index;
+    p_index m_p_index;
 };
 }  // namespace rdf
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 
-#include "util_types.hpp"
+#include <future>
+
+#include "inverted_index.hpp"
 #include "parameters.hpp"
+#include "util_types.hpp"
 
 namespace rdf {
 
@@ -10,36 +13,52 @@ struct index_2tp {
     typedef SPO spo_type;
     typedef POS pos_type;
 
+    // the predicates of every object, so that (?,?,o) only visits the
+    // predicates that o has, instead of searching o under every predicate
+    typedef inverted_index<POS> o_index;
+
     struct builder {
         builder(parameters const& params)
             : m_params(params)
             , m_spo(permutation_type::spo, params)
-            , m_pos(permutation_type::pos, params) {}
+            , m_pos(permutation_type::pos, params)
+            , m_o_index(params.objects(), params.num_elements[4],
+                        params.predicates()) {}
 
+        // The two tries are built concurrently; the index on objects only
+        // needs POS, so it is built by the same task right after it.
         void build(index_2tp<SPO, POS>& index) {
-            util::logger("building first and second levels...");
-            m_spo.build_first_and_second_level(index.m_spo, m_params);
-            util::logger("SPO DONE");
-            m_pos.build_first_and_second_level(index.m_pos, m_params);
-            util::logger("POS DONE");
-            util::logger("building third levels...");
-            m_spo.build_third_level(index.m_spo, m_params);
-            util::logger("SPO DONE");
-            m_pos.build_third_level(index.m_pos, m_params);
-            util::logger("POS DONE");
+            util::logger("building tries...");
+            auto spo = std::async(std::launch::async, [&]() {
+                m_spo.build(index.m_spo, m_params);
+                util::logger("SPO DONE");
+            });
+            auto pos = std::async(std::launch::async, [&]() {
+                m_pos.build(index.m_pos, m_params);
+                util::logger("POS DONE");
+                m_o_index.build(index.m_o_index, index.m_pos);
+                util::logger("index on objects DONE");
+            });
+            spo.get();
+            pos.get();
         }
 
     private:
         parameters const& m_params;
         typename SPO::builder m_spo;
         typename POS::builder m_pos;
+
+        typename o_index::builder m_o_index;
     };
 
     struct iterator {
-        iterator(index_2tp& index)
-            : m_perm(permutation_type::spo), m_spo(index.m_spo.select_all()) {}
+        iterator(index_2tp const& index)
+            : m_perm(permutation_type::spo)
+            , m_by_object(false)
+            , m_spo(index.m_spo.select_all()) {}
 
-        iterator(triplet const& t, index_2tp& index) {
+        iterator(triplet const& t, index_2tp const& index)
+            : m_by_object(false) {
             triplet permuted;
             m_perm = index_2tp::permute(t, permuted);
             switch (m_perm) {
@@ -50,10 +69,17 @@ struct index_2tp {
                     m_pos = index.m_pos.select(permuted);
                     break;
                 case permutation_type::osp:
-                    m_osp = index.m_spo.select_so(permuted);
+                    m_by_object = index.so_by_object(permuted);
+                    if (m_by_object) {
+                        m_osp_pos = index.m_o_index.select(
+                            permuted.third, permuted.first, &(index.m_pos));
+                    } else {
+                        m_osp = index.m_spo.select_so(permuted);
+                    }
                     break;
                 case permutation_type::ops:
-                    m_ops = index.m_pos.select_o(permuted);
+                    m_ops = index.m_o_index.select(permuted.second,
+                                                   &(index.m_pos));
                     break;
                 default:
                     assert(false);
@@ -68,7 +94,8 @@ struct index_2tp {
             case permutation_type::pos:                        \
                 return m_pos.METHOD ACTUALS;                   \
             case permutation_type::osp:                        \
-                return m_osp.METHOD ACTUALS;                   \
+                return m_by_object ? m_osp_pos.METHOD ACTUALS  \
+                                   : m_osp.METHOD ACTUALS;     \
             case permutation_type::ops:                        \
                 return m_ops.METHOD ACTUALS;                   \
             default:                                           \
@@ -81,31 +108,146 @@ struct index_2tp {
         ITERATOR_METHOD(bool, has_next, (), ());
         ITERATOR_METHOD(void, operator++,(), ());
         ITERATOR_METHOD(triplet, operator*,(), ());
+        ITERATOR_METHOD(uint64_t, next_batch, (triplet* out, uint64_t n),
+                        (out, n));
 
 #undef ITERATOR_METHOD
 
     private:
         int m_perm;
+        bool m_by_object;
         union {
             typename SPO::iterator m_spo;
             typename POS::iterator m_pos;
             typename SPO::iterator_so m_osp;
-            typename POS::iterator_po m_ops;
+            typename o_index::filter_iterator m_osp_pos;
+            typename o_index::iterator m_ops;
         };
     };
 
-    iterator select(triplet const& t) {
+    iterator select(triplet const& t) const {
         return iterator(t, *this);
     }
 
-    iterator select_all() {
+    // A seekable iterator over the trie of one of the permutations
+    // (see trie::cursor).
+    struct cursor {
+        cursor(int perm, index_2tp const& index) : m_perm(perm) {
+            switch (m_perm) {
+                case permutation_type::spo:
+                    m_spo = index.m_spo.open_cursor();
+                    break;
+                case permutation_type::pos:
+                    m_pos = index.m_pos.open_cursor();
+                    break;
+                default:
+                    assert(false);
+            }
+        }
+
+#define CURSOR_METHOD(RETURN_TYPE, METHOD, FORMALS, ACTUALS)   \
+    RETURN_TYPE METHOD FORMALS {                               \
+        switch (m_perm) {                                      \
+            case permutation_type::spo:                        \
+                return m_spo.METHOD ACTUALS;                   \
+            case permutation_type::pos:                        \
+                return m_pos.METHOD ACTUALS;                   \
+            default:                                           \
+                assert(false);                                 \
+                __builtin_unreachable();                       \
+        }                                                      \
+    }                                                          \
+    /**/
+
+        CURSOR_METHOD(uint32_t, depth, (), ());
+        CURSOR_METHOD(void, open, (), ());
+        CURSOR_METHOD(void, up, (), ());
+        CURSOR_METHOD(bool, at_end, (), ());
+        CURSOR_METHOD(uint64_t, key, (), ());
+        CURSOR_METHOD(void, next, (), ());
+        CURSOR_METHOD(void, seek, (uint64_t k), (k));
+
+#undef CURSOR_METHOD
+
+    private:
+        int m_perm;
+        union {
+            typename SPO::cursor m_spo;
+            typename POS::cursor m_pos;
+        };
+    };
+
+    // the permutations that are stored as tries
+    static std::vector<int> permutations() {
+        return {permutation_type::spo, permutation_type::pos};
+    }
+
+    cursor open_cursor(int perm) const {
+        return cursor(perm, *this);
+    }
+
+    iterator select_all() const {
         return iterator(*this);
     }
 
-    uint64_t is_member(triplet const& t) {
+    uint64_t is_member(triplet const& t) const {
         return m_spo.is_member(t);
     }
 
+    void is_member(triplet const* queries, uint64_t n, uint64_t* out) const {
+        m_spo.is_member(queries, n, out);
+    }
+
+    // whether (s,?,o) searches s under the predicates of o in POS, as
+    // listed by the index on objects, two searches each, rather than o
+    // under those of s in SPO
+    bool so_by_object(triplet const& t) const {
+        return rdf::so_by_object(
+            m_spo.children(t.first),
+            [&]() { return m_o_index.size(t.third); }, 2);
+    }
+
+    // number of triples matching t: (s,?,o) probes the third level of SPO
+    // or POS (see so_by_object); (?,?,o) sums the sizes of the ranges of o
+    // under the predicates of o, without accessing the third level
+    uint64_t count(triplet const& t) const {
+        if (num_wildcards(t) == 3) return triplets();
+        triplet permuted;
+        switch (index_2tp::permute(t, permuted)) {
+            case permutation_type::spo:
+                return m_spo.count(permuted);
+            case permutation_type::pos:
+                return m_pos.count(permuted);
+            case permutation_type::osp:
+                return so_by_object(permuted)
+                           ? m_o_index.count(permuted.third, permuted.first,
+                                             &m_pos)
+                           : m_spo.count_so(permuted);
+            case permutation_type::ops:
+                return m_o_index.count(permuted.second, &m_pos);
+            default:
+                assert(false);
+                __builtin_unreachable();
+        }
+    }
+
+    // an upper bound to count(t), that never accesses a third level
+    uint64_t count_upper_bound(triplet const& t) const {
+        if (num_wildcards(t) == 0) {
+            triplet sp = t;
+            sp.third = global::wildcard_symbol;
+            return std::min<uint64_t>(count(sp), 1);
+        }
+        if (num_wildcards(t) == 1 and t.second == global::wildcard_symbol) {
+            triplet s = t;
+            triplet o = t;
+            s.third = global::wildcard_symbol;
+            o.first = global::wildcard_symbol;
+            return std::min(count(s), count(o));
+        }
+        return count(t);
+    }
+
     void print_stats(essentials::json_lines& stats);
 
     uint64_t triplets() const {
@@ -114,7 +256,7 @@ struct index_2tp {
     }
 
     size_t bytes() const {
-        return m_spo.bytes() + m_pos.bytes();
+        return m_spo.bytes() + m_pos.bytes() + m_o_index.bytes();
     }
 
     auto& spo() {
@@ -125,10 +267,21 @@ struct index_2tp {
         return m_pos;
     }
 
+    auto& objects_index() {
+        return m_o_index;
+    }
+
     template <typename Visitor>
     void visit(Visitor& visitor) {
         visitor.visit(m_spo);
         visitor.visit(m_pos);
+        visitor.visit(m_o_index);
+    }
+
+    // the permutation in which select(t) returns the triples
+    static int select_permutation(triplet const& t) {
+        triplet permuted;
+        return index_2tp::permute(t, permuted);
     }
 
     static int permute(triplet const& t, triplet& permuted) {
@@ -153,5 +306,6 @@ struct index_2tp {
 private:
     SPO m_spo;
     POS m_pos;
+    o_index m_o_index;
 };
 }  // namespace rdf
\ No newline at end of file
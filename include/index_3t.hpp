@@ -1,5 +1,7 @@
 #pragma once
 
+#include <future>
+
 #include "util_types.hpp"
 #include "parameters.hpp"
 
@@ -18,25 +20,37 @@ struct index_3t {
             , m_pos(permutation_type::pos, params)
             , m_osp(permutation_type::osp, params) {}
 
+        // The three tries are built concurrently. The third levels of SPO
+        // and POS may be mapped through OSP, so they are completed only
+        // after OSP is ready.
         void build(index_3t<SPO, POS, OSP>& index) {
-            util::logger("building first and second levels...");
-            m_spo.build_first_and_second_level(index.m_spo, m_params);
-            util::logger("SPO DONE");
-            m_pos.build_first_and_second_level(index.m_pos, m_params);
-            util::logger("POS DONE");
-            m_osp.build_first_and_second_level(index.m_osp, m_params);
-            util::logger("OSP DONE");
-
-            m_spo.mapper.initialize(&(index.m_osp));
-            m_pos.mapper.initialize(&(index.m_osp));
-
-            util::logger("building third levels...");
-            m_spo.build_third_level(index.m_spo, m_params);
-            util::logger("SPO DONE");
-            m_pos.build_third_level(index.m_pos, m_params);
-            util::logger("POS DONE");
-            m_osp.build_third_level(index.m_osp, m_params);
-            util::logger("OSP DONE");
+            util::logger("building tries...");
+
+            auto osp = std::async(std::launch::async, [&]() {
+                m_osp.build_first_and_second_level(index.m_osp, m_params);
+                m_osp.build_third_level(index.m_osp);
+                util::logger("OSP DONE");
+            }).share();
+
+            auto spo = std::async(std::launch::async, [&]() {
+                m_spo.build_first_and_second_level(index.m_spo, m_params);
+                osp.get();
+                m_spo.mapper.initialize(&(index.m_osp));
+                m_spo.build_third_level(index.m_spo);
+                util::logger("SPO DONE");
+            });
+
+            auto pos = std::async(std::launch::async, [&]() {
+                m_pos.build_first_and_second_level(index.m_pos, m_params);
+                osp.get();
+                m_pos.mapper.initialize(&(index.m_osp));
+                m_pos.build_third_level(index.m_pos);
+                util::logger("POS DONE");
+            });
+
+            osp.get();
+            spo.get();
+            pos.get();
         }
 
     private:
@@ -47,10 +61,10 @@ struct index_3t {
     };
 
     struct iterator {
-        iterator(index_3t& index)
+        iterator(index_3t const& index)
             : m_perm(permutation_type::spo), m_spo(index.m_spo.select_all()) {}
 
-        iterator(triplet const& t, index_3t& index) {
+        iterator(triplet const& t, index_3t const& index) {
             triplet permuted;
             m_perm = index_3t::permute(t, permuted);
             switch (m_perm) {
@@ -87,6 +101,8 @@ struct index_3t {
         ITERATOR_METHOD(bool, has_next, (), ());
         ITERATOR_METHOD(void, operator++,(), ());
         ITERATOR_METHOD(triplet, operator*,(), ());
+        ITERATOR_METHOD(uint64_t, next_batch, (triplet* out, uint64_t n),
+                        (out, n));
 
 #undef ITERATOR_METHOD
 
@@ -99,18 +115,114 @@ struct index_3t {
         };
     };
 
-    iterator select(triplet const& t) {
+    iterator select(triplet const& t) const {
         return iterator(t, *this);
     }
 
-    iterator select_all() {
+    // A seekable iterator over the trie of one of the permutations
+    // (see trie::cursor).
+    struct cursor {
+        cursor(int perm, index_3t const& index) : m_perm(perm) {
+            switch (m_perm) {
+                case permutation_type::spo:
+                    m_spo = index.m_spo.open_cursor();
+                    break;
+                case permutation_type::pos:
+                    m_pos = index.m_pos.open_cursor();
+                    break;
+                case permutation_type::osp:
+                    m_osp = index.m_osp.open_cursor();
+                    break;
+                default:
+                    assert(false);
+            }
+        }
+
+#define CURSOR_METHOD(RETURN_TYPE, METHOD, FORMALS, ACTUALS)   \
+    RETURN_TYPE METHOD FORMALS {                               \
+        switch (m_perm) {                                      \
+            case permutation_type::spo:                        \
+                return m_spo.METHOD ACTUALS;                   \
+            case permutation_type::pos:                        \
+                return m_pos.METHOD ACTUALS;                   \
+            case permutation_type::osp:                        \
+                return m_osp.METHOD ACTUALS;                   \
+            default:                                           \
+                assert(false);                                 \
+                __builtin_unreachable();                       \
+        }                                                      \
+    }                                                          \
+    /**/
+
+        CURSOR_METHOD(uint32_t, depth, (), ());
+        CURSOR_METHOD(void, open, (), ());
+        CURSOR_METHOD(void, up, (), ());
+        CURSOR_METHOD(bool, at_end, (), ());
+        CURSOR_METHOD(uint64_t, key, (), ());
+        CURSOR_METHOD(void, next, (), ());
+        CURSOR_METHOD(void, seek, (uint64_t k), (k));
+
+#undef CURSOR_METHOD
+
+    private:
+        int m_perm;
+        union {
+            typename SPO::cursor m_spo;
+            typename POS::cursor m_pos;
+            typename OSP::cursor m_osp;
+        };
+    };
+
+    // the permutations that are stored as tries
+    static std::vector<int> permutations() {
+        return {permutation_type::spo, permutation_type::pos,
+                permutation_type::osp};
+    }
+
+    cursor open_cursor(int perm) const {
+        return cursor(perm, *this);
+    }
+
+    iterator select_all() const {
         return iterator(*this);
     }
 
-    uint64_t is_member(triplet const& t) {
+    uint64_t is_member(triplet const& t) const {
         return m_spo.is_member(t);
     }
 
+    void is_member(triplet const* queries, uint64_t n, uint64_t* out) const {
+        m_spo.is_member(queries, n, out);
+    }
+
+    // number of triples matching t: every pattern is a prefix of one of
+    // the permutations, so only (s,p,o) accesses a third level
+    uint64_t count(triplet const& t) const {
+        if (num_wildcards(t) == 3) return triplets();
+        triplet permuted;
+        switch (index_3t::permute(t, permuted)) {
+            case permutation_type::spo:
+                return m_spo.count(permuted);
+            case permutation_type::pos:
+                return m_pos.count(permuted);
+            case permutation_type::osp:
+                return m_osp.count(permuted);
+            default:
+                assert(false);
+                __builtin_unreachable();
+        }
+    }
+
+    // an upper bound to count(t), that never accesses a third level
+    uint64_t count_upper_bound(triplet const& t) const {
+        if (num_wildcards(t) == 0) {
+            triplet sp = t;
+            sp.third = global::wildcard_symbol;
+            return std::min<uint64_t>(count(sp), 1);
+        }
+        return count(t);
+    }
+
     void print_stats(essentials::json_lines& stats);
 
     uint64_t triplets() const {
@@ -156,6 +268,12 @@ struct index_3t {
         m_pos.mapper.initialize(&m_osp);
     }
 
+    // the permutation in which select(t) returns the triples
+    static int select_permutation(triplet const& t) {
+        triplet permuted;
+        return index_3t::permute(t, permuted);
+    }
+
     static int permute(triplet const& t, triplet& permuted) {
         // less code?
 
@@ -0,0 +1,301 @@
+#pragma once
+
+#include "compact_vector.hpp"
+#include "util_types.hpp"
+
+namespace rdf {
+
+/*
+    The inverse of the first two levels of a trie: for every second-level
+    id y, the sorted list of the first-level nodes x having y as a child.
+    It answers (?,y,?) on the trie by only visiting the nodes that y is
+    below, instead of searching y under every first-level node.
+    On SPO it lists the subjects of every predicate, on POS the predicates
+    of every object.
+*/
+template <typename Trie,
+          typename Nodes = typename Trie::levels_type::first::nodes_type,
+          typename Pointers = typename Trie::levels_type::first::pointers_type>
+struct inverted_index {
+    struct builder {
+        builder() {}
+
+        // keys: the number of second-level ids; pairs: the number of
+        // (x,y) pairs; universe: the number of first-level nodes
+        builder(uint64_t keys, uint64_t pairs, uint64_t universe)
+            : m_keys(keys), m_pairs(pairs) {
+            resize(pointers, keys + 1, pairs);
+            resize(nodes, pairs, universe);
+        }
+
+        // the (x,y) pairs are read from the first two levels of the
+        // (already built) trie
+        void build(inverted_index& index, Trie const& trie) {
+            std::vector<uint64_t> offsets(m_keys + 1, 0);
+
+            auto for_each_pair = [&](auto f) {
+                uint64_t pairs = trie.second.size();
+                typename Trie::levels_type::second::iterator it(
+                    trie.second.nodes.begin(), trie.first.pointers.begin());
+                uint64_t x = 0;
+                for (uint64_t i = 0; i != pairs; ++i) {
+                    f(x, *it);
+                    if (i + 1 != pairs and ++it) ++x;
+                }
+            };
+
+            // 1. count the pairs of each key to build the offsets
+            {
+                for_each_pair([&](uint64_t /* x */, uint64_t y) {
+                    ++offsets[y + 1];  // shifted by 1
+                });
+
+                // transform the counts in offsets
+                for (uint64_t i = 2; i < offsets.size(); ++i) {
+                    offsets[i] += offsets[i - 1];
+                }
+
+                std::cout << "  offsets.back() = " << offsets.back()
+                          << std::endl;
+                std::cout << "  pairs = " << m_pairs << std::endl;
+                assert(offsets.back() == m_pairs);
+                pointers.fill(offsets.begin(), offsets.size());
+                index.pointers.build(pointers, false);
+            }
+
+            // 2. distribute the nodes to build the sequence: they are
+            // sorted as the pairs are visited by node
+            for_each_pair([&](uint64_t x, uint64_t y) {
+                uint64_t& next = offsets[y];
+                nodes.set(next, x);
+                ++next;
+            });
+
+            index.nodes.build(nodes, pointers);
+
+            std::cout << "  pointers take: "
+                      << index.pointers.bytes() * 8.0 / trie.triplets()
+                      << " [bpt]" << std::endl;
+            std::cout << "  nodes take: "
+                      << index.nodes.bytes() * 8.0 / trie.triplets()
+                      << " [bpt]" << std::endl;
+        }
+
+        compact_vector::builder pointers;
+        compact_vector::builder nodes;
+
+    private:
+        uint64_t m_keys;
+        uint64_t m_pairs;
+    };
+
+    // returns the triples (y,x,z) of the trie, sorted by x then z
+    struct iterator {
+        iterator(uint64_t y, inverted_index const* data, Trie const* trie)
+            : m_i(0), m_j(0), m_children(0), m_trie(trie) {
+            m_val.first = y;
+            m_val.second = 0;
+            m_val.third = 0;
+
+            auto r = (data->pointers)[y];
+            m_nodes = r.end - r.begin;
+            m_nodes_it = typename Trie::levels_type::first::iterator(
+                (data->nodes).at(r, r.begin), (data->pointers).at(y));
+        }
+
+        bool has_next() {
+            while (m_j < m_children) {
+                return true;
+            }
+
+            while (m_i < m_nodes) {
+                uint64_t x = *m_nodes_it;
+                auto r = (m_trie->first).pointers[x];
+                uint64_t pos = (m_trie->second).nodes.find(r, m_val.first);
+                assert(pos != global::not_found);
+
+                m_val.second = x;
+                r = (m_trie->second).pointers[pos];
+                m_j = 0;
+                m_children = r.end - r.begin;
+                m_children_it = typename Trie::levels_type::third::iterator(
+                    (m_trie->third).nodes.at(r, r.begin),
+                    (m_trie->second).pointers.at(pos));
+
+                ++m_nodes_it;
+                ++m_i;
+
+                return true;
+            }
+
+            return false;
+        }
+
+        void operator++() {
+            ++m_j;
+            ++m_children_it;
+        }
+
+        triplet operator*() {
+            m_val.third = *m_children_it;
+            return m_val;
+        }
+
+        uint64_t next_batch(triplet* out, uint64_t n) {
+            uint64_t i = 0;
+            for (; i != n and has_next(); ++i, operator++()) {
+                out[i] = operator*();
+            }
+            return i;
+        }
+
+    private:
+        triplet m_val;
+        uint64_t m_i;
+        uint64_t m_j;
+        uint64_t m_nodes;
+        uint64_t m_children;
+        Trie const* m_trie;
+        typename Trie::levels_type::third::iterator m_children_it;
+        typename Trie::levels_type::first::iterator m_nodes_it;
+    };
+
+    // returns the triples (y,z,x) of the trie, for a given z, sorted by x:
+    // z is searched under every node x of y
+    struct filter_iterator {
+        filter_iterator(uint64_t y, uint64_t z, inverted_index const* data,
+                        Trie const* trie)
+            : m_i(0), m_trie(trie) {
+            m_val.first = y;
+            m_val.second = z;
+            m_val.third = 0;
+
+            auto r = (data->pointers)[y];
+            m_nodes = r.end - r.begin;
+            m_nodes_it = typename Trie::levels_type::first::iterator(
+                (data->nodes).at(r, r.begin), (data->pointers).at(y));
+        }
+
+        bool has_next() {
+            while (m_i < m_nodes) {
+                m_val.third = *m_nodes_it;
+                if (is_member(*m_trie, m_val.third, m_val.first,
+                              m_val.second)) {
+                    return true;
+                }
+                this->operator++();
+            }
+            return false;
+        }
+
+        void operator++() {
+            if (++m_i < m_nodes) ++m_nodes_it;
+        }
+
+        triplet operator*() {
+            return m_val;
+        }
+
+        uint64_t next_batch(triplet* out, uint64_t n) {
+            uint64_t i = 0;
+            for (; i != n and has_next(); ++i, operator++()) {
+                out[i] = operator*();
+            }
+            return i;
+        }
+
+    private:
+        triplet m_val;
+        uint64_t m_i;
+        uint64_t m_nodes;
+        Trie const* m_trie;
+        typename Trie::levels_type::first::iterator m_nodes_it;
+    };
+
+    iterator select(uint64_t y, Trie const* trie) const {
+        return iterator(y, this, trie);
+    }
+
+    filter_iterator select(uint64_t y, uint64_t z, Trie const* trie) const {
+        return filter_iterator(y, z, this, trie);
+    }
+
+    // number of triples (x,y,z) of the trie: the third level is not
+    // accessed
+    uint64_t count(uint64_t y, Trie const* trie) const {
+        if (y + 1 >= pointers.size()) return 0;
+        auto r = pointers[y];
+        typename Trie::levels_type::first::iterator nodes_it(
+            nodes.at(r, r.begin), pointers.at(y));
+        uint64_t n = 0;
+        for (uint64_t i = r.begin; i != r.end; ++i) {
+            uint64_t x = *nodes_it;
+            auto rx = (trie->first).pointers[x];
+            uint64_t pos = (trie->second).nodes.find(rx, y);
+            assert(pos != global::not_found);
+            rx = (trie->second).pointers[pos];
+            n += rx.end - rx.begin;
+            if (i + 1 != r.end) ++nodes_it;
+        }
+        return n;
+    }
+
+    // number of triples (x,y,z) of the trie, for a given z
+    uint64_t count(uint64_t y, uint64_t z, Trie const* trie) const {
+        auto it = select(y, z, trie);
+        uint64_t n = 0;
+        for (; it.has_next(); ++it) ++n;
+        return n;
+    }
+
+    // number of nodes x having y as a child
+    uint64_t size(uint64_t y) const {
+        if (y + 1 >= pointers.size()) return 0;
+        auto r = pointers[y];
+        return r.end - r.begin;
+    }
+
+    size_t bytes() const {
+        return pointers.bytes() + nodes.bytes();
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(pointers);
+        visitor.visit(nodes);
+    }
+
+    Pointers pointers;
+    Nodes nodes;
+
+private:
+    // whether (x,y,z) is in the trie, where x is a node of y
+    static bool is_member(Trie const& trie, uint64_t x, uint64_t y,
+                          uint64_t z) {
+        auto r = trie.first.pointers[x];
+        uint64_t j = trie.second.nodes.find(r, y);
+        assert(j != global::not_found);
+        r = trie.second.pointers[j];
+        return trie.third.nodes.find(r, z) != global::not_found;
+    }
+};
+
+/*
+    (s,?,o) is answered by searching o under the predicates of s in SPO,
+    or s under the predicates of o on the side of the objects, with
+    searches_per_predicate searches for each predicate of o. Opening the
+    side of the objects costs about as much as a few searches in SPO,
+    hence the margin. The predicates of o are only counted, by calling
+    object_predicates(), if s has enough of them for that side to pay off.
+*/
+template <typename ObjectPredicates>
+inline bool so_by_object(uint64_t subject_predicates,
+                         ObjectPredicates const& object_predicates,
+                         uint64_t searches_per_predicate) {
+    static const uint64_t margin = 8;
+    if (subject_predicates <= margin + searches_per_predicate) return false;
+    uint64_t n = object_predicates();
+    return n != 0 and searches_per_predicate * n + margin < subject_predicates;
+}
+
+}  // namespace rdf
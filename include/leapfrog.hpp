@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "bgp.hpp"
+#include "util_types.hpp"
+
+namespace rdf {
+
+// Leapfrog triejoin over the tries of an index: a worst-case optimal join
+// that binds one variable at a time, intersecting the keys of all the
+// patterns containing that variable by seeking their cursors forward.
+// Each pattern is read from a permutation whose trie lists its constants
+// first and then its variables in the global order of the variables, so the
+// order is chosen among those compatible with the permutations of Index.
+// Patterns repeating a variable are not supported.
+template <typename Index>
+struct leapfrog_join {
+    leapfrog_join(Index const& index,
+                  std::vector<triple_pattern> const& patterns)
+        : m_index(&index), m_patterns(patterns) {
+        uint64_t num_variables = 0;
+        for (auto const& pattern : patterns) {
+            for (uint32_t i = 0; i != 3; ++i) {
+                if (pattern[i].is_variable) {
+                    num_variables =
+                        std::max(num_variables, pattern[i].value + 1);
+                }
+            }
+        }
+        plan(num_variables);
+    }
+
+    struct iterator {
+        iterator(leapfrog_join const& join)
+            : m_join(&join)
+            , m_bindings(join.m_order.size(), global::wildcard_symbol)
+            , m_depth(0)
+            , m_has_next(true) {
+            auto const& index = *(join.m_index);
+            auto const& atoms = join.m_atoms;
+            m_cursors.reserve(atoms.size());
+            for (auto const& a : atoms) {
+                m_cursors.push_back(index.open_cursor(a.perm));
+                auto& c = m_cursors.back();
+                for (uint32_t i = 0; i != a.constants; ++i) {
+                    c.open();
+                    if (c.at_end()) {
+                        m_has_next = false;
+                        break;
+                    }
+                    c.seek(a.keys[i]);
+                    if (c.at_end() or c.key() != a.keys[i]) {
+                        m_has_next = false;
+                        break;
+                    }
+                }
+            }
+
+            uint64_t depths = join.m_order.size();
+            m_participants.resize(depths);
+            m_p.resize(depths);
+            if (!m_has_next or depths == 0) return;
+            run(open_depth(0));
+        }
+
+        bool has_next() const {
+            return m_has_next;
+        }
+
+        // the values of the variables, indexed by variable
+        std::vector<uint64_t> const& operator*() const {
+            return m_bindings;
+        }
+
+        void operator++() {
+            if (m_join->m_order.empty()) {
+                m_has_next = false;
+                return;
+            }
+            run(next_key(m_depth));
+        }
+
+    private:
+        leapfrog_join const* m_join;
+        std::vector<uint64_t> m_bindings;
+        std::vector<typename Index::cursor> m_cursors;
+        // the cursors taking part in the intersection at each depth,
+        // sorted by key when the depth is opened
+        std::vector<std::vector<uint32_t>> m_participants;
+        std::vector<uint32_t> m_p;
+        uint64_t m_depth;
+        bool m_has_next;
+
+        // descend while keys are found and backtrack when a depth is
+        // exhausted, until the next solution or the end
+        void run(bool found) {
+            uint64_t depths = m_join->m_order.size();
+            while (true) {
+                if (found) {
+                    if (m_depth + 1 == depths) return;
+                    ++m_depth;
+                    found = open_depth(m_depth);
+                } else {
+                    for (auto a : m_participants[m_depth]) m_cursors[a].up();
+                    if (m_depth == 0) {
+                        m_has_next = false;
+                        return;
+                    }
+                    --m_depth;
+                    found = next_key(m_depth);
+                }
+            }
+        }
+
+        bool open_depth(uint64_t d) {
+            auto& participants = m_participants[d];
+            participants = m_join->m_participants[d];
+            bool empty = false;
+            for (auto a : participants) {
+                m_cursors[a].open();
+                if (m_cursors[a].at_end()) empty = true;
+            }
+            if (empty) return false;
+            std::sort(participants.begin(), participants.end(),
+                      [&](uint32_t x, uint32_t y) {
+                          return m_cursors[x].key() < m_cursors[y].key();
+                      });
+            m_p[d] = 0;
+            return search(d);
+        }
+
+        bool next_key(uint64_t d) {
+            auto const& participants = m_participants[d];
+            auto& c = m_cursors[participants[m_p[d]]];
+            c.next();
+            if (c.at_end()) return false;
+            m_p[d] = (m_p[d] + 1) % participants.size();
+            return search(d);
+        }
+
+        // leapfrog search: seek the cursors, in round-robin order, to the
+        // largest key among them until all agree
+        bool search(uint64_t d) {
+            auto const& participants = m_participants[d];
+            uint64_t k = participants.size();
+            uint32_t& p = m_p[d];
+            uint64_t max = m_cursors[participants[(p + k - 1) % k]].key();
+            while (true) {
+                auto& c = m_cursors[participants[p]];
+                uint64_t key = c.key();
+                if (key == max) {
+                    m_bindings[m_join->m_order[d]] = key;
+                    return true;
+                }
+                c.seek(max);
+                if (c.at_end()) return false;
+                max = c.key();
+                p = (p + 1) % k;
+            }
+        }
+    };
+
+    iterator select() const {
+        return iterator(*this);
+    }
+
+    uint64_t variables() const {
+        return m_order.size();
+    }
+
+    // the variables, in the order in which they are bound
+    std::vector<uint64_t> const& order() const {
+        return m_order;
+    }
+
+private:
+    struct atom {
+        int perm;
+        uint32_t constants;
+        uint64_t keys[3];  // the constants, in the order of perm
+    };
+
+    Index const* m_index;
+    std::vector<triple_pattern> m_patterns;
+    std::vector<uint64_t> m_order;
+    std::vector<atom> m_atoms;
+    std::vector<std::vector<uint32_t>> m_participants;
+
+    // the components (s,p,o) = (0,1,2) in the order of perm
+    static std::vector<uint32_t> components(int perm) {
+        switch (perm) {
+            case permutation_type::spo:
+                return {0, 1, 2};
+            case permutation_type::pos:
+                return {1, 2, 0};
+            case permutation_type::osp:
+                return {2, 0, 1};
+            case permutation_type::ops:
+                return {2, 1, 0};
+            case permutation_type::pso:
+                return {1, 0, 2};
+            default:
+                assert(false);
+                __builtin_unreachable();
+        }
+    }
+
+    // true if the trie of perm lists the constants of the pattern first and
+    // then its variables by increasing rank, where the variables that are
+    // not ranked yet (rank == unranked) can only come last
+    static bool compatible(triple_pattern const& pattern, int perm,
+                           std::vector<uint64_t> const& rank,
+                           uint64_t unranked) {
+        bool variables = false;
+        uint64_t last = 0;
+        for (auto i : components(perm)) {
+            auto const& c = pattern[i];
+            if (!c.is_variable) {
+                if (variables) return false;
+                continue;
+            }
+            uint64_t r = rank[c.value];
+            if (variables and (r < last or (r == last and r != unranked))) {
+                return false;
+            }
+            variables = true;
+            last = r;
+        }
+        return true;
+    }
+
+    // Build the order one variable at a time, trying first the variables
+    // shared by more patterns, and only extend an order if every pattern
+    // has a permutation still compatible with it. The search backtracks on
+    // dead ends, and gives up after max_plan_steps extensions.
+    void plan(uint64_t num_variables) {
+        std::vector<uint64_t> occurrences(num_variables, 0);
+        std::vector<std::vector<uint64_t>> patterns_of(num_variables);
+        for (uint64_t j = 0; j != m_patterns.size(); ++j) {
+            for (uint32_t i = 0; i != 3; ++i) {
+                auto const& c = m_patterns[j][i];
+                if (!c.is_variable) continue;
+                // a variable bound by one level of the trie cannot be
+                // checked against another level of the same pattern
+                if (patterns_of[c.value].size() and
+                    patterns_of[c.value].back() == j) {
+                    throw std::invalid_argument(
+                        "variable " + std::to_string(c.value) +
+                        " is repeated in pattern " + std::to_string(j) +
+                        ": not supported by leapfrog_join");
+                }
+                ++occurrences[c.value];
+                patterns_of[c.value].push_back(j);
+            }
+        }
+        for (uint64_t v = 0; v != num_variables; ++v) {
+            if (!occurrences[v]) {
+                throw std::invalid_argument("variable " + std::to_string(v) +
+                                            " does not occur in any pattern");
+            }
+        }
+
+        std::vector<uint64_t> variables(num_variables);
+        std::iota(variables.begin(), variables.end(), 0);
+        std::stable_sort(variables.begin(), variables.end(),
+                         [&](uint64_t x, uint64_t y) {
+                             return occurrences[x] > occurrences[y];
+                         });
+
+        auto const available = Index::permutations();
+        std::vector<uint64_t> rank(num_variables, num_variables);
+        uint64_t steps = 0;
+        bool found = std::all_of(
+            m_patterns.begin(), m_patterns.end(),
+            [&](triple_pattern const& pattern) {
+                return std::any_of(
+                    available.begin(), available.end(), [&](int perm) {
+                        return compatible(pattern, perm, rank, num_variables);
+                    });
+            });
+        m_order.clear();
+        if (!found or !extend(variables, patterns_of, available, rank, steps)) {
+            throw std::invalid_argument(
+                steps > max_plan_steps
+                    ? "no order of the variables found within the search "
+                      "limit"
+                    : "no order of the variables is compatible with the "
+                      "permutations of the index");
+        }
+
+        std::vector<int> perms(m_patterns.size());
+        for (uint64_t j = 0; j != m_patterns.size(); ++j) {
+            for (auto perm : available) {
+                if (compatible(m_patterns[j], perm, rank, num_variables)) {
+                    perms[j] = perm;
+                    break;
+                }
+            }
+        }
+        build_atoms(perms);
+    }
+
+    static const uint64_t max_plan_steps = 1 << 16;
+
+    // appends to m_order a variable keeping every pattern compatible with
+    // some permutation, and recurses; false if no order is found
+    bool extend(std::vector<uint64_t> const& variables,
+                std::vector<std::vector<uint64_t>> const& patterns_of,
+                std::vector<int> const& available, std::vector<uint64_t>& rank,
+                uint64_t& steps) {
+        uint64_t num_variables = variables.size();
+        uint64_t depth = m_order.size();
+        if (depth == num_variables) return true;
+        for (auto v : variables) {
+            if (rank[v] != num_variables) continue;
+            if (++steps > max_plan_steps) return false;
+            rank[v] = depth;
+            bool ok = true;
+            for (auto j : patterns_of[v]) {
+                ok = std::any_of(available.begin(), available.end(),
+                                 [&](int perm) {
+                                     return compatible(m_patterns[j], perm,
+                                                       rank, num_variables);
+                                 });
+                if (!ok) break;
+            }
+            if (ok) {
+                m_order.push_back(v);
+                if (extend(variables, patterns_of, available, rank, steps)) {
+                    return true;
+                }
+                m_order.pop_back();
+            }
+            rank[v] = num_variables;
+            if (steps > max_plan_steps) return false;
+        }
+        return false;
+    }
+
+    void build_atoms(std::vector<int> const& perms) {
+        std::vector<uint64_t> rank(m_order.size());
+        for (uint64_t i = 0; i != m_order.size(); ++i) rank[m_order[i]] = i;
+        m_participants.resize(m_order.size());
+        for (uint64_t j = 0; j != m_patterns.size(); ++j) {
+            atom a;
+            a.perm = perms[j];
+            a.constants = 0;
+            for (auto i : components(a.perm)) {
+                auto const& c = m_patterns[j][i];
+                if (c.is_variable) {
+                    m_participants[rank[c.value]].push_back(j);
+                } else {
+                    a.keys[a.constants++] = c.value;
+                }
+            }
+            m_atoms.push_back(a);
+        }
+    }
+};
+
+}  // namespace rdf
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace rdf {
+
+/*
+    A read-only array that either owns its elements, or is a
+    non-owning view over memory it does not manage (e.g., a
+    memory-mapped index file: see serialization.hpp).
+*/
+template <typename T>
+struct mappable_vector {
+    typedef T value_type;
+    typedef T const* const_iterator;
+
+    mappable_vector() : m_data(nullptr), m_size(0) {}
+
+    mappable_vector(mappable_vector const& other) : mappable_vector() {
+        *this = other;
+    }
+
+    mappable_vector(mappable_vector&& other) : mappable_vector() {
+        swap(other);
+    }
+
+    mappable_vector& operator=(mappable_vector const& other) {
+        if (this == &other) return *this;
+        if (other.owning()) {
+            m_vec = other.m_vec;
+            reset();
+        } else {
+            std::vector<T>().swap(m_vec);
+            m_data = other.m_data;
+            m_size = other.m_size;
+        }
+        return *this;
+    }
+
+    mappable_vector& operator=(mappable_vector&& other) {
+        swap(other);
+        return *this;
+    }
+
+    // take ownership of the elements of vec, leaving it empty
+    void steal(std::vector<T>& vec) {
+        m_vec.swap(vec);
+        std::vector<T>().swap(vec);
+        reset();
+    }
+
+    // view n elements starting at data, without owning them
+    void view(T const* data, size_t n) {
+        std::vector<T>().swap(m_vec);
+        m_data = data;
+        m_size = n;
+    }
+
+    void swap(mappable_vector& other) {
+        m_vec.swap(other.m_vec);
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+    }
+
+    bool owning() const {
+        return m_data == m_vec.data();
+    }
+
+    inline T const& operator[](size_t i) const {
+        assert(i < m_size);
+        return m_data[i];
+    }
+
+    T const* data() const {
+        return m_data;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    T const& back() const {
+        assert(m_size);
+        return m_data[m_size - 1];
+    }
+
+    const_iterator begin() const {
+        return m_data;
+    }
+
+    const_iterator end() const {
+        return m_data + m_size;
+    }
+
+    size_t bytes() const {
+        return sizeof(m_size) + m_size * sizeof(T);
+    }
+
+    // generic visitors (e.g., essentials::sizer) see an owned std::vector
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        if (!owning()) {
+            m_vec.assign(begin(), end());
+            reset();
+        }
+        visitor.visit(m_vec);
+        reset();
+    }
+
+private:
+    std::vector<T> m_vec;
+    T const* m_data;
+    size_t m_size;
+
+    void reset() {
+        m_data = m_vec.data();
+        m_size = m_vec.size();
+    }
+};
+
+}  // namespace rdf
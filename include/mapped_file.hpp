@@ -0,0 +1,79 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace rdf {
+
+// read-only memory mapping of a whole file
+struct mapped_file {
+    mapped_file() : m_data(nullptr), m_size(0) {}
+
+    mapped_file(char const* filename, int advice = MADV_NORMAL)
+        : mapped_file() {
+        open(filename, advice);
+    }
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    ~mapped_file() {
+        close();
+    }
+
+    void open(char const* filename, int advice = MADV_NORMAL) {
+        close();
+        int fd = ::open(filename, O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error("Error in opening file '" +
+                                     std::string(filename) + "'.");
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            ::close(fd);
+            throw std::runtime_error("Error in reading size of file '" +
+                                     std::string(filename) + "'.");
+        }
+
+        m_size = st.st_size;
+        if (m_size) {
+            void* addr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Error in mapping file '" +
+                                         std::string(filename) + "'.");
+            }
+            m_data = static_cast<uint8_t const*>(addr);
+            madvise(addr, m_size, advice);
+        }
+        ::close(fd);  // the mapping stays valid
+    }
+
+    void close() {
+        if (m_data) {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    uint8_t const* data() const {
+        return m_data;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+private:
+    uint8_t const* m_data;
+    size_t m_size;
+};
+
+}  // namespace rdf
@@ -7,13 +7,18 @@ namespace rdf {
 struct identity_mapper {
     typedef void mapper_index_type;
 
-    void initialize(mapper_index_type* /* mapper */) {}
+    void initialize(mapper_index_type const* /* mapper */) {}
 
-    inline uint64_t map(triplet const& t) {
+    inline uint64_t map(triplet const& t) const {
         return t.third;
     }
 
-    inline uint64_t unmap(triplet const& t) {
+    // map the smallest value >= t.third
+    inline uint64_t map_geq(triplet const& t) const {
+        return t.third;
+    }
+
+    inline uint64_t unmap(triplet const& t) const {
         return t.third;
     }
 };
@@ -22,25 +27,34 @@ template <typename Index>
 struct sorted_array_mapper {
     typedef Index mapper_index_type;
 
-    inline uint64_t get_parent(triplet const& t) {
+    inline uint64_t get_parent(triplet const& t) const {
         return t.second;
     }
 
-    void initialize(mapper_index_type* mapper) {
+    void initialize(mapper_index_type const* mapper) {
         m_mapper = mapper;
     }
 
-    inline uint64_t map(triplet const& t) {
+    inline uint64_t map(triplet const& t) const {
         auto r = (m_mapper->first).pointers[get_parent(t)];
         return (m_mapper->second).nodes.find(r, t.third) - r.begin;
     }
 
-    inline uint64_t unmap(triplet const& t) {
+    // map the smallest value >= t.third among the children of the parent,
+    // or return the number of children if there is none: mapping is
+    // monotone, so the order of the third level is preserved
+    inline uint64_t map_geq(triplet const& t) const {
+        auto r = (m_mapper->first).pointers[get_parent(t)];
+        return (m_mapper->second).nodes.next_geq(r, r.begin, t.third) -
+               r.begin;
+    }
+
+    inline uint64_t unmap(triplet const& t) const {
         auto r = (m_mapper->first).pointers[get_parent(t)];
         return (m_mapper->second).nodes.access(r, t.third + r.begin);
     }
 
 private:
-    mapper_index_type* m_mapper;
+    mapper_index_type const* m_mapper;
 };
 }  // namespace rdf
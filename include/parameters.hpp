@@ -8,7 +8,10 @@ namespace rdf {
 
 struct parameters {
     parameters()
-        : num_triplets(0), num_elements(6, 0), collection_basename(nullptr) {}
+        : num_triplets(0)
+        , num_elements(6, 0)
+        , collection_basename(nullptr)
+        , space_weight(0.5) {}
 
     void load() {
         std::string filename = std::string(collection_basename) + ".stats";
@@ -113,6 +116,9 @@ struct parameters {
     // num_elements[5] = num. of distinct pairs (o,s)
     std::vector<uint64_t> num_elements;
     char const* collection_basename;
+
+    // option of the levels encoded with auto_sequence
+    double space_weight;  // in [0, 1]
 };
 
 }  // namespace rdf
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "pef_parameters.hpp"
+#include "util.hpp"
+#include "bit_vector.hpp"
+
+namespace rdf {
+namespace pef {
+
+// The run of the n consecutive values up to universe - 1: it takes no
+// space, as its values follow from their positions. Since partitions are
+// encoded relative to the last value of the previous one, runs may start
+// from 1 as well as from 0.
+struct all_ones_sequence {
+    static uint64_t bitsize(pef_parameters const& /* params */,
+                            uint64_t universe, uint64_t n) {
+        return (universe - n <= 1) ? 0 : uint64_t(-1);
+    }
+
+    template <typename Iterator>
+    static void write(rdf::bit_vector_builder& /* bvb */, Iterator begin,
+                      uint64_t universe, uint64_t n,
+                      pef_parameters const& /* params */) {
+        assert(*begin == universe - n);
+        (void)begin;
+        (void)universe;
+        (void)n;
+    }
+
+    struct enumerator {
+        typedef std::pair<uint64_t, uint64_t> value_type;  // (position, value)
+
+        enumerator() {}
+
+        enumerator(rdf::bit_vector const& /* bv */, uint64_t /* offset */,
+                   uint64_t universe, uint64_t n,
+                   pef_parameters const& /* params */)
+            : m_first(universe - n), m_size(n), m_position(n) {}
+
+        value_type move(uint64_t position) {
+            assert(position <= size());
+            m_position = position;
+            return value();
+        }
+
+        value_type next_geq(uint64_t lower_bound) {
+            assert(lower_bound <= m_first + size());
+            m_position = lower_bound > m_first ? lower_bound - m_first : 0;
+            return value();
+        }
+
+        value_type next() {
+            return move(m_position + 1);
+        }
+
+        uint64_t size() const {
+            return m_size;
+        }
+
+        uint64_t prev_value() const {
+            return m_position ? m_first + m_position - 1 : 0;
+        }
+
+        uint64_t position() const {
+            return m_position;
+        }
+
+        inline value_type value() const {
+            return value_type(m_position, m_first + m_position);
+        }
+
+    private:
+        uint64_t m_first;
+        uint64_t m_size;
+        uint64_t m_position;
+    };
+};
+}  // namespace pef
+}  // namespace rdf
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+
+#include "pef_parameters.hpp"
+#include "util.hpp"
+#include "bit_vector.hpp"
+#include "compact_ef.hpp"
+#include "compact_ranked_bitvector.hpp"
+#include "all_ones_sequence.hpp"
+
+namespace rdf {
+namespace pef {
+
+// A sequence encoded with the cheapest of Elias-Fano, a ranked bitmap or
+// an implicit run of consecutive values. Only Elias-Fano encodes repeated
+// values. The type is not written with the sequence: the caller stores it
+// in type_bits next to the offset of the sequence, so that it is known
+// before the sequence is read.
+struct indexed_sequence {
+    enum index_type {
+        elias_fano = 0,
+        ranked_bitvector = 1,
+        all_ones = 2,
+    };
+
+    static const uint64_t type_bits = 2;
+
+    // the space of the encoding chosen by best_type for n values up to
+    // universe - 1, the first being first, that are distinct if distinct
+    static uint64_t bitsize(pef_parameters const& params, uint64_t universe,
+                            uint64_t n, uint64_t first, bool distinct) {
+        uint64_t best_cost = compact_ef::bitsize(params, universe, n);
+        if (distinct) {
+            best_cost = std::min(
+                best_cost,
+                compact_ranked_bitvector::bitsize(params, universe, n));
+            if (first + n == universe) best_cost = 0;  // all_ones
+        }
+        return best_cost;
+    }
+
+    template <typename Iterator>
+    static index_type best_type(Iterator begin, uint64_t universe, uint64_t n,
+                                pef_parameters const& params) {
+        bool distinct = true;
+        Iterator it = begin;
+        uint64_t first = *it;
+        uint64_t last = first;
+        for (uint64_t i = 1; i < n; ++i) {
+            uint64_t v = *++it;
+            distinct &= v != last;
+            last = v;
+        }
+
+        index_type best_type = elias_fano;
+        uint64_t best_cost = compact_ef::bitsize(params, universe, n);
+        if (distinct) {
+            uint64_t rb_cost =
+                compact_ranked_bitvector::bitsize(params, universe, n);
+            if (rb_cost < best_cost) {
+                best_cost = rb_cost;
+                best_type = ranked_bitvector;
+            }
+            if (last + 1 == universe and last - first + 1 == n) {
+                best_type = all_ones;
+            }
+        }
+        return best_type;
+    }
+
+    template <typename Iterator>
+    static void write(rdf::bit_vector_builder& bvb, Iterator begin,
+                      uint64_t universe, uint64_t n,
+                      pef_parameters const& params, index_type type) {
+        switch (type) {
+            case elias_fano:
+                compact_ef::write(bvb, begin, universe, n, params);
+                break;
+            case ranked_bitvector:
+                compact_ranked_bitvector::write(bvb, begin, universe, n,
+                                                params);
+                break;
+            case all_ones:
+                all_ones_sequence::write(bvb, begin, universe, n, params);
+                break;
+        }
+    }
+
+    struct enumerator {
+        typedef std::pair<uint64_t, uint64_t> value_type;  // (position, value)
+
+        enumerator() {}
+
+        enumerator(index_type type, rdf::bit_vector const& bv, uint64_t offset,
+                   uint64_t universe, uint64_t n, pef_parameters const& params)
+            : m_type(type) {
+            switch (m_type) {
+                case elias_fano:
+                    m_ef_enum = compact_ef::enumerator(bv, offset, universe,
+                                                       n, params);
+                    break;
+                case ranked_bitvector:
+                    m_rb_enum = compact_ranked_bitvector::enumerator(
+                        bv, offset, universe, n, params);
+                    break;
+                case all_ones:
+                    m_ao_enum = all_ones_sequence::enumerator(
+                        bv, offset, universe, n, params);
+                    break;
+            }
+        }
+
+        value_type move(uint64_t position) {
+            switch (m_type) {
+                case elias_fano:
+                    return m_ef_enum.move(position);
+                case ranked_bitvector:
+                    return m_rb_enum.move(position);
+                default:
+                    return m_ao_enum.move(position);
+            }
+        }
+
+        value_type next_geq(uint64_t lower_bound) {
+            switch (m_type) {
+                case elias_fano:
+                    return m_ef_enum.next_geq(lower_bound);
+                case ranked_bitvector:
+                    return m_rb_enum.next_geq(lower_bound);
+                default:
+                    return m_ao_enum.next_geq(lower_bound);
+            }
+        }
+
+        value_type next() {
+            switch (m_type) {
+                case elias_fano:
+                    return m_ef_enum.next();
+                case ranked_bitvector:
+                    return m_rb_enum.next();
+                default:
+                    return m_ao_enum.next();
+            }
+        }
+
+        uint64_t size() const {
+            switch (m_type) {
+                case elias_fano:
+                    return m_ef_enum.size();
+                case ranked_bitvector:
+                    return m_rb_enum.size();
+                default:
+                    return m_ao_enum.size();
+            }
+        }
+
+        uint64_t prev_value() const {
+            switch (m_type) {
+                case elias_fano:
+                    return m_ef_enum.prev_value();
+                case ranked_bitvector:
+                    return m_rb_enum.prev_value();
+                default:
+                    return m_ao_enum.prev_value();
+            }
+        }
+
+        value_type value() const {
+            switch (m_type) {
+                case elias_fano:
+                    return m_ef_enum.value();
+                case ranked_bitvector:
+                    return m_rb_enum.value();
+                default:
+                    return m_ao_enum.value();
+            }
+        }
+
+    private:
+        index_type m_type;
+        // only the enumerator of m_type is used: overlapping them halves
+        // the size of the enumerator, that is copied at every partition
+        // switch
+        union {
+            compact_ef::enumerator m_ef_enum;
+            compact_ranked_bitvector::enumerator m_rb_enum;
+            all_ones_sequence::enumerator m_ao_enum;
+        };
+    };
+};
+}  // namespace pef
+}  // namespace rdf
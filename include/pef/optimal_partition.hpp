@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "util.hpp"
+
+namespace rdf {
+namespace pef {
+
+// Approximate dynamic programming for the partition of a sorted sequence
+// that minimizes its encoded size. Partitions are encoded relative to the
+// last value of the previous partition, so the universe of a partition
+// spans from that value to its own last value.
+// Finds a solution within (1 + eps1)(1 + eps2) of the optimum by
+// considering, for each start, only windows whose cost is close to a
+// geometric sequence of cost bounds.
+struct optimal_partition {
+    std::vector<uint64_t> partition;  // end positions, the last one is n
+    uint64_t cost_opt;
+
+    template <typename Iterator>
+    struct cost_window {
+        cost_window(Iterator begin, uint64_t base, uint64_t cost_upper_bound)
+            : start_it(begin)
+            , end_it(begin)
+            , min_p(base)
+            , max_p(0)
+            , cost_upper_bound(cost_upper_bound) {}
+
+        uint64_t universe() const {
+            return max_p - min_p + 1;
+        }
+
+        uint64_t size() const {
+            return end - start;
+        }
+
+        // the first value in the window, relative to min_p
+        uint64_t first() const {
+            return *start_it - min_p;
+        }
+
+        bool distinct() const {
+            return repeats == 0;
+        }
+
+        void advance_start() {
+            min_p = *start_it;
+            ++start;
+            ++start_it;
+            if (start < end and *start_it == min_p) --repeats;
+        }
+
+        void advance_end() {
+            if (end > start and *end_it == max_p) ++repeats;
+            max_p = *end_it;
+            ++end;
+            ++end_it;
+        }
+
+        uint64_t start = 0;
+        uint64_t end = 0;
+        Iterator start_it;
+        Iterator end_it;
+        uint64_t min_p;  // value preceding the window
+        uint64_t max_p;  // last value in the window
+        uint64_t repeats = 0;  // values equal to the previous in the window
+        uint64_t cost_upper_bound;
+    };
+
+    // Partition the n values from begin, that are encoded relative to base.
+    // cost_fun(universe, n, first, distinct) is the cost of a partition of
+    // n values whose first value is first, including the fixed cost of its
+    // entries in the directories.
+    template <typename Iterator, typename CostFunction>
+    optimal_partition(Iterator begin, uint64_t base, uint64_t n,
+                      CostFunction cost_fun, double eps1, double eps2) {
+        assert(n > 0);
+        uint64_t universe = *(begin + (n - 1)) - base + 1;
+        bool distinct = true;
+        for (Iterator it = begin + 1; it != begin + n and distinct; ++it) {
+            distinct = *it != *(it - 1);
+        }
+        uint64_t single_partition_cost =
+            cost_fun(universe, n, *begin - base, distinct);
+
+        std::vector<uint64_t> min_cost(n + 1, single_partition_cost);
+        min_cost[0] = 0;
+
+        // one window per cost bound, from the cheapest possible partition
+        // up to a single partition
+        std::vector<cost_window<Iterator>> windows;
+        uint64_t cost_lb = cost_fun(1, 1, 0, true);
+        double cost_bound = cost_lb;
+        while (eps1 == 0 or cost_bound < cost_lb / eps1) {
+            windows.emplace_back(begin, base, uint64_t(cost_bound));
+            if (cost_bound >= single_partition_cost) break;
+            cost_bound *= 1 + eps2;
+        }
+
+        std::vector<uint64_t> path(n + 1, 0);
+        for (uint64_t i = 0; i != n; ++i) {
+            uint64_t last_end = i + 1;
+            for (auto& window : windows) {
+                assert(window.start == i);
+                while (window.end < last_end) window.advance_end();
+                while (true) {
+                    uint64_t window_cost =
+                        cost_fun(window.universe(), window.size(),
+                                 window.first(), window.distinct());
+                    if (min_cost[i] + window_cost < min_cost[window.end]) {
+                        min_cost[window.end] = min_cost[i] + window_cost;
+                        path[window.end] = i;
+                    }
+                    last_end = window.end;
+                    if (window.end == n) break;
+                    if (window_cost >= window.cost_upper_bound) break;
+                    window.advance_end();
+                }
+                window.advance_start();
+            }
+        }
+
+        for (uint64_t pos = n; pos; pos = path[pos]) {
+            partition.push_back(pos);
+        }
+        std::reverse(partition.begin(), partition.end());
+        cost_opt = min_cost[n];
+    }
+};
+
+}  // namespace pef
+}  // namespace rdf
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <future>
 #include <stdexcept>
+#include <thread>
 
 #include "bit_vector.hpp"
 #include "compact_ef.hpp"
 #include "compact_vector.hpp"
+#include "indexed_sequence.hpp"
 #include "integer_codes.hpp"
+#include "optimal_partition.hpp"
 #include "util.hpp"
 
 namespace rdf {
@@ -14,11 +18,95 @@ namespace pef {
 namespace global {
 static const uint64_t linear_scan_threshold = 8;
 static const uint64_t log_partition_size = 7;
+// do not spawn tasks for fewer partitions than this
+static const uint64_t min_partitions_per_task = 1 << 12;
+// values partitioned optimally on their own: fixed, so that the partition
+// does not depend on the number of cores
+static const uint64_t optimal_partition_chunk = uint64_t(1) << 22;
+// approximation factors of the optimal partitioning
+static const double eps1 = 0.03;
+static const double eps2 = 0.3;
+// bits taken by a partition in the endpoint and upper bound directories
+static const uint64_t partition_fixed_cost = 64;
 }  // namespace global
 
-struct pef_sequence {
-    pef_sequence()
-        : m_size(0), m_universe(0), m_partitions(0), m_log_partition_size(0) {}
+// Partitions of 2^global::log_partition_size elements, located by shifts.
+struct uniform_partitions {
+    static const bool variable = false;
+
+    struct enumerator {
+        enumerator() {}
+
+        enumerator(rdf::bit_vector const& /* bv */, uint64_t /* offset */,
+                   uint64_t /* size */, uint64_t /* partitions */) {}
+
+        // the partition holding position
+        uint64_t partition(uint64_t position) {
+            return position >> global::log_partition_size;
+        }
+
+        // a partition at or after the one holding end - 1
+        uint64_t last_partition(uint64_t end) {
+            return end >> global::log_partition_size;
+        }
+
+        // the positions [begin, end) of partition p among size elements
+        void bounds(uint64_t p, uint64_t size, uint64_t& begin,
+                    uint64_t& end) {
+            begin = p << global::log_partition_size;
+            end = std::min(size, (p + 1) << global::log_partition_size);
+        }
+    };
+};
+
+// Partitions of variable lengths, whose end positions are encoded with
+// compact_ef after the endpoints.
+struct variable_partitions {
+    static const bool variable = true;
+
+    struct enumerator {
+        enumerator() {}
+
+        enumerator(rdf::bit_vector const& bv, uint64_t offset, uint64_t size,
+                   uint64_t partitions)
+            : m_ends(bv, offset, size, partitions - 1, pef_parameters()) {}
+
+        uint64_t partition(uint64_t position) {
+            return m_ends.next_geq(position + 1).first;
+        }
+
+        uint64_t last_partition(uint64_t end) {
+            return m_ends.next_geq(end).first;
+        }
+
+        void bounds(uint64_t p, uint64_t /* size */, uint64_t& begin,
+                    uint64_t& end) {
+            end = m_ends.move(p).second;
+            begin = p ? m_ends.prev_value() : 0;
+        }
+
+    private:
+        compact_ef::enumerator m_ends;  // the last one is the size
+    };
+};
+
+// Each partition is encoded with the cheapest indexed_sequence. The
+// layout of the partitions is fixed at compile time, so that iterators
+// over uniform partitions do not pay for variable ones.
+template <typename Partitions>
+struct basic_pef_sequence {
+    basic_pef_sequence()
+        : m_size(0)
+        , m_universe(0)
+        , m_partitions(0)
+        , m_log_partition_size(0)
+        , m_endpoints_offset(0)
+        , m_endpoint_bits(0)
+        , m_ends_offset(0)
+        , m_sequences_offset(0)
+        , m_base(0)
+        , m_upper_bound(0)
+        , m_type(indexed_sequence::elias_fano) {}
 
     void build(compact_vector::builder const& from,
                compact_vector::builder const& pointers) {
@@ -61,12 +149,23 @@ struct pef_sequence {
         assert(n > 0);
         m_size = n;
         m_universe = universe;
-        m_log_partition_size = global::log_partition_size;
 
         pef_parameters params;
-        uint64_t partition_size = uint64_t(1) << m_log_partition_size;
-        size_t partitions = util::ceil_div(n, partition_size);
+        std::vector<uint64_t> ends;  // end position of each partition
+        if (Partitions::variable) {
+            m_log_partition_size = 0;
+            optimal_partitions(begin, n).swap(ends);
+        } else {
+            m_log_partition_size = global::log_partition_size;
+            uint64_t partition_size = uint64_t(1) << m_log_partition_size;
+            for (uint64_t end = partition_size; end < n;
+                 end += partition_size) {
+                ends.push_back(end);
+            }
+            ends.push_back(n);
+        }
 
+        size_t partitions = ends.size();
         m_partitions = partitions;
 
         rdf::bit_vector_builder data_bvb;
@@ -94,41 +193,63 @@ struct pef_sequence {
                 }
             }
 
-            compact_ef::write(data_bvb, cur_partition.begin(),
-                              cur_partition.back() + 1, cur_partition.size(),
-                              params);
+            auto type = indexed_sequence::best_type(
+                cur_partition.begin(), cur_partition.back() + 1,
+                cur_partition.size(), params);
+            data_bvb.append_bits(type, indexed_sequence::type_bits);
+            indexed_sequence::write(data_bvb, cur_partition.begin(),
+                                    cur_partition.back() + 1,
+                                    cur_partition.size(), params, type);
         } else {
             rdf::bit_vector_builder bv_sequences;
             std::vector<uint64_t> endpoints;
+            std::vector<uint64_t> types;
             std::vector<uint64_t> upper_bounds;
-
-            uint64_t cur_i = 0;
-            Iterator it = begin;
-            cur_base = *begin;
-            upper_bounds.push_back(cur_base);
-
-            for (size_t p = 0; p < partitions; ++p) {
-                cur_partition.clear();
-                uint64_t value = 0;
-                for (; cur_i < ((p + 1) * partition_size) && cur_i < n;
-                     ++cur_i, ++it) {
-                    value = *it;
-                    cur_partition.push_back(value - cur_base);
+            upper_bounds.reserve(partitions + 1);
+            upper_bounds.push_back(*begin);
+
+            // Partitions are independent given their base, so chunks of
+            // them are encoded concurrently into local bit vectors that
+            // are then concatenated in order.
+            uint64_t tasks = std::min<uint64_t>(
+                std::max<unsigned>(std::thread::hardware_concurrency(), 1),
+                partitions / global::min_partitions_per_task);
+            if (tasks <= 1) {
+                write_partitions(begin, ends, 0, partitions, bv_sequences,
+                                 endpoints, types, upper_bounds);
+            } else {
+                uint64_t chunk = util::ceil_div(partitions, tasks);
+                std::vector<rdf::bit_vector_builder> bvbs(tasks);
+                std::vector<std::vector<uint64_t>> chunk_endpoints(tasks);
+                std::vector<std::vector<uint64_t>> chunk_types(tasks);
+                std::vector<std::vector<uint64_t>> chunk_upper_bounds(tasks);
+                std::vector<std::future<void>> futures;
+                for (uint64_t t = 0; t != tasks; ++t) {
+                    uint64_t p_begin = std::min(t * chunk, partitions);
+                    uint64_t p_end = std::min(p_begin + chunk, partitions);
+                    auto encode = [&, t, p_begin, p_end]() {
+                        write_partitions(begin, ends, p_begin, p_end, bvbs[t],
+                                         chunk_endpoints[t], chunk_types[t],
+                                         chunk_upper_bounds[t]);
+                    };
+                    futures.push_back(std::async(std::launch::async, encode));
+                }
+                endpoints.reserve(partitions);
+                types.reserve(partitions);
+                for (uint64_t t = 0; t != tasks; ++t) {
+                    futures[t].get();
+                    uint64_t offset = bv_sequences.size();
+                    for (auto e : chunk_endpoints[t]) {
+                        endpoints.push_back(offset + e);
+                    }
+                    types.insert(types.end(), chunk_types[t].begin(),
+                                 chunk_types[t].end());
+                    upper_bounds.insert(upper_bounds.end(),
+                                        chunk_upper_bounds[t].begin(),
+                                        chunk_upper_bounds[t].end());
+                    bv_sequences.append(bvbs[t]);
+                    rdf::bit_vector_builder().swap(bvbs[t]);
                 }
-
-                assert(cur_partition.size() <= partition_size);
-                assert((p == partitions - 1) or
-                       cur_partition.size() == partition_size);
-
-                uint64_t upper_bound = value;
-                assert(cur_partition.size() > 0);
-
-                compact_ef::write(bv_sequences, cur_partition.begin(),
-                                  cur_partition.back() + 1,
-                                  cur_partition.size(), params);
-                endpoints.push_back(bv_sequences.size());
-                upper_bounds.push_back(upper_bound);
-                cur_base = upper_bound;
             }
 
             upper_bounds_cvb.resize(upper_bounds.size(),
@@ -137,10 +258,19 @@ struct pef_sequence {
                 upper_bounds_cvb.push_back(u);
             }
 
+            // the type of each partition is stored with its endpoint, so
+            // that it is known without reading the partition
             uint64_t endpoint_bits = util::ceil_log2(bv_sequences.size() + 1);
             write_gamma(data_bvb, endpoint_bits);
-            for (uint64_t p = 0; p < endpoints.size() - 1; ++p) {
-                data_bvb.append_bits(endpoints[p], endpoint_bits);
+            for (uint64_t p = 0; p < partitions; ++p) {
+                data_bvb.append_bits(
+                    (endpoints[p] << indexed_sequence::type_bits) | types[p],
+                    endpoint_bits + indexed_sequence::type_bits);
+            }
+            if (Partitions::variable) {
+                // the end of the last partition is the size
+                compact_ef::write(data_bvb, ends.begin(), n, partitions - 1,
+                                  params);
             }
 
             data_bvb.append(bv_sequences);
@@ -148,18 +278,20 @@ struct pef_sequence {
 
         upper_bounds_cvb.build(m_upper_bounds);
         m_data.build(&data_bvb);
-        m_it = iterator(*this);
+        read_header();
     }
 
-    inline uint64_t access(uint64_t pos) {
-        return m_it.move(pos).second;
+    inline uint64_t access(uint64_t pos) const {
+        iterator it(*this, {0, 0}, pos);
+        return it.value();
     }
 
-    inline uint64_t access(range const& r, uint64_t pos) {
-        return access(pos) - previous_range_upperbound(r);
+    inline uint64_t access(range const& r, uint64_t pos) const {
+        iterator it(*this, r, pos);
+        return it.value();
     }
 
-    uint64_t find(range const& r, uint64_t id) {
+    uint64_t find(range const& r, uint64_t id) const {
         assert(r.end > r.begin);
         assert(r.end <= size());
 
@@ -183,16 +315,10 @@ struct pef_sequence {
             return rdf::global::not_found;
         }
 
-        if (m_partitions > 1) {
-            uint64_t partition_begin = r.begin >> m_log_partition_size;
-            m_it.switch_partition(partition_begin);
-        }
-
-        uint64_t prev_upper = previous_range_upperbound(r);
-        id += prev_upper;
-        uint64_t partition_end = r.end >> m_log_partition_size;
-        m_it.move(r.begin);  // id must be found in range
-        auto pos_value = m_it.next_geq(id, r, partition_end);
+        // a local cursor, so that concurrent searches do not interfere
+        iterator it(*this, r, r.begin);  // id must be found in range
+        id += it.m_prev_range_upper_bound;
+        auto pos_value = it.next_geq(id, r);
         if (pos_value.second == id) {
             return pos_value.first;
         }
@@ -200,51 +326,70 @@ struct pef_sequence {
         return rdf::global::not_found;
     }
 
+    // position of the first element >= id in [pos, r.end), or r.end
+    uint64_t next_geq(range const& r, uint64_t pos, uint64_t id) const {
+        assert(r.begin <= pos and pos <= r.end);
+        if (pos == r.end) return r.end;
+
+        iterator it(*this, r, pos);
+        if (it.value() >= id) return pos;
+        id += it.m_prev_range_upper_bound;
+        if (r.end - pos <= global::linear_scan_threshold) {
+            while (++pos != r.end) {
+                if (it.next() >= id) break;
+            }
+            return pos;
+        }
+
+        auto pos_value = it.next_geq(id, r);
+        if (pos_value.second == rdf::global::not_found or
+            pos_value.first >= r.end) {
+            return r.end;
+        }
+        return pos_value.first;
+    }
+
     struct iterator {
         typedef std::pair<uint64_t, uint64_t> value_type;  // (position, value)
 
         iterator() {}
 
-        iterator(pef_sequence& pef, range r = {0, 0}, uint64_t pos = 0) {
+        // Move to pos in r. The header was decoded by the sequence, so
+        // this only copies its offsets and locates the partition of pos.
+        iterator(basic_pef_sequence const& pef, range r = {0, 0},
+                 uint64_t pos = 0) {
             m_partitions = pef.m_partitions;
             m_size = pef.m_size;
             m_universe = pef.m_universe;
             m_bv = &(pef.m_data);
             m_upper_bounds = &(pef.m_upper_bounds);
-            m_log_partition_size = pef.m_log_partition_size;
-            m_position = pos;
-
-            m_prev_range_upper_bound = pef.previous_range_upperbound(r);
+            m_endpoints_offset = pef.m_endpoints_offset;
+            m_endpoint_bits = pef.m_endpoint_bits;
+            m_sequences_offset = pef.m_sequences_offset;
 
-            pef_parameters params;
-            rdf::bits_iterator<rdf::bit_vector> it(*m_bv);
             if (m_partitions == 1) {
                 m_cur_partition = 0;
                 m_cur_begin = 0;
                 m_cur_end = m_size;
-
-                uint64_t universe_bits = util::ceil_log2(m_universe + 1);
-                m_cur_base = it.get_bits(universe_bits);
-                auto ub = 0;
-                if (m_size > 1) {
-                    uint64_t universe_delta = read_delta(it);
-                    ub = universe_delta ? universe_delta
-                                        : (m_universe - m_cur_base - 1);
-                }
-
-                m_partition_enum = compact_ef::enumerator(
-                    *m_bv, it.position(), ub + 1, m_size, params);
-                m_cur_upper_bound = m_cur_base + ub;
-
+                m_cur_base = pef.m_base;
+                m_cur_upper_bound = pef.m_base + pef.m_upper_bound;
+                m_partition_enum = indexed_sequence::enumerator(
+                    pef.m_type, *m_bv, m_sequences_offset,
+                    pef.m_upper_bound + 1, m_size, m_params);
             } else {
-                m_endpoint_bits = read_gamma(it);
-                uint64_t cur_offset = it.position();
-                m_endpoints_offset = cur_offset;
-                uint64_t endpoints_size = m_endpoint_bits * (m_partitions - 1);
-                cur_offset += endpoints_size;
-                m_sequences_offset = cur_offset;
-                slow_move();
+                m_cur_begin = m_cur_end = 0;  // no partition yet
+                m_bounds = typename Partitions::enumerator(
+                    *m_bv, pef.m_ends_offset, m_size, m_partitions);
+            }
+
+            // the upper bound of the previous range is the value before
+            // r.begin, read from the partition of r.begin
+            m_prev_range_upper_bound = 0;
+            if (r.begin) {
+                move(r.begin);
+                m_prev_range_upper_bound = prev_value();
             }
+            move(pos);
         }
 
         value_type ALWAYSINLINE move(uint64_t position) {
@@ -259,8 +404,8 @@ struct pef_sequence {
             return slow_move();
         }
 
-        value_type ALWAYSINLINE next_geq(uint64_t lower_bound, range const& r,
-                                         uint64_t partition_end) {
+        value_type ALWAYSINLINE next_geq(uint64_t lower_bound,
+                                         range const& r) {
             if (LIKELY(lower_bound >= m_cur_base &&
                        lower_bound <= m_cur_upper_bound)) {
                 auto val = m_partition_enum.next_geq(lower_bound - m_cur_base);
@@ -272,22 +417,29 @@ struct pef_sequence {
                 return value_type(m_position, m_cur_base + val.second);
             }
 
-            if (m_cur_partition >
-                partition_end) {  // out of bounds form the right
+            if (lower_bound < m_cur_base) {  // out of bounds form the left
                 return value_type(m_position, rdf::global::not_found);
             }
 
-            if (lower_bound < m_cur_base) {  // out of bounds form the left
+            uint64_t last = partition_end(r);
+            if (m_cur_partition > last) {  // out of bounds form the right
                 return value_type(m_position, rdf::global::not_found);
             }
 
-            return slow_next_geq(lower_bound, r, partition_end);
+            return slow_next_geq(lower_bound, r, last);
         }
 
         uint64_t size() const {
             return m_size;
         }
 
+        // index of a partition at or after the one holding r.end - 1,
+        // that bounds the searches in r
+        uint64_t partition_end(range const& r) {
+            if (m_partitions == 1) return 0;
+            return m_bounds.last_partition(r.end);
+        }
+
         uint64_t prev_value() {
             if (UNLIKELY(m_position == m_cur_begin)) {
                 m_last = m_cur_partition ? m_cur_base : 0;
@@ -358,8 +510,7 @@ struct pef_sequence {
                 m_partition_enum.move(m_partition_enum.size());
                 return value_type(m_position, m_universe);
             }
-            uint64_t partition = m_position >> m_log_partition_size;
-            switch_partition(partition);
+            switch_partition(m_bounds.partition(m_position));
             uint64_t val =
                 m_cur_base +
                 m_partition_enum.move(m_position - m_cur_begin).second;
@@ -389,13 +540,46 @@ struct pef_sequence {
             }
 
             switch_partition(partition_id - 1);
-            return next_geq(lower_bound, r, partition_end);
+            return next_geq(lower_bound, r);
         }
 
         void switch_range() {
             m_prev_range_upper_bound = m_last;
         }
 
+        // Write the next n values to out, moving onto the last of them.
+        // begins[i] != 0 if the i-th value begins a range: the upper bound
+        // of the previous range is then switched without branching.
+        void next_values(uint64_t* out, uint64_t n, uint32_t const* begins) {
+            uint64_t base = m_prev_range_upper_bound;
+            uint64_t last = m_last;
+            for (uint64_t i = 0; i != n; ++i) {
+                uint64_t val = next();
+                base = begins[i] ? last : base;
+                last = val;
+                out[i] = val - base;
+            }
+            m_prev_range_upper_bound = base;
+            m_last = last;
+        }
+
+        // Move to the first value >= lower_bound in [position, r.end) and
+        // return its position. If there is none, move to r.end - 1 and
+        // return r.end.
+        uint64_t next_geq(range const& r, uint64_t lower_bound) {
+            lower_bound += m_prev_range_upper_bound;
+            if (m_cur_base + m_partition_enum.value().second >= lower_bound) {
+                return m_position;
+            }
+            auto pos_value = next_geq(lower_bound, r);
+            if (pos_value.second == rdf::global::not_found or
+                pos_value.first >= r.end) {
+                move(r.end - 1);
+                return r.end;
+            }
+            return pos_value.first;
+        }
+
         uint64_t value() {
             uint64_t offset = m_partition_enum.value().second;
             m_last = m_cur_base + offset;
@@ -430,32 +614,28 @@ struct pef_sequence {
         void switch_partition(uint64_t partition) {
             assert(m_partitions > 1);
 
-            uint64_t endpoint =
-                partition
-                    ? m_bv->get_bits(m_endpoints_offset +
-                                         (partition - 1) * m_endpoint_bits,
-                                     m_endpoint_bits)
-                    : 0;
+            uint64_t endpoint = m_bv->get_bits(
+                m_endpoints_offset + partition * m_endpoint_bits,
+                m_endpoint_bits);
+            auto type = indexed_sequence::index_type(
+                endpoint & ((uint64_t(1) << indexed_sequence::type_bits) - 1));
 
-            m_cur_partition_begin = m_sequences_offset + endpoint;
+            m_cur_partition_begin =
+                m_sequences_offset + (endpoint >> indexed_sequence::type_bits);
             util::prefetch(m_bv->data().data() + m_cur_partition_begin / 64);
 
             m_cur_partition = partition;
-            m_cur_begin = partition << m_log_partition_size;
-            m_cur_end =
-                std::min(size(), (partition + 1) << m_log_partition_size);
+            m_bounds.bounds(partition, m_size, m_cur_begin, m_cur_end);
 
             m_cur_upper_bound = m_upper_bounds->access(partition + 1);
             m_cur_base = m_upper_bounds->access(partition);
 
-            m_partition_enum =
-                compact_ef::enumerator(*m_bv, m_cur_partition_begin,
-                                       m_cur_upper_bound - m_cur_base + 1,
-                                       m_cur_end - m_cur_begin, m_params);
+            m_partition_enum = indexed_sequence::enumerator(
+                type, *m_bv, m_cur_partition_begin,
+                m_cur_upper_bound - m_cur_base + 1, m_cur_end - m_cur_begin,
+                m_params);
         }
 
-        uint8_t m_log_partition_size;
-
         pef_parameters m_params;
         uint64_t m_partitions;
         uint64_t m_endpoints_offset;
@@ -476,15 +656,16 @@ struct pef_sequence {
         uint64_t m_last;
 
         rdf::bit_vector const* m_bv;
-        compact_ef::enumerator m_partition_enum;
+        indexed_sequence::enumerator m_partition_enum;
+        typename Partitions::enumerator m_bounds;
         rdf::compact_vector const* m_upper_bounds;
     };
 
-    iterator begin() {
+    iterator begin() const {
         return iterator(*this);
     }
 
-    iterator at(range const& r, uint64_t pos) {
+    iterator at(range const& r, uint64_t pos) const {
         return iterator(*this, r, pos);
     }
 
@@ -518,30 +699,209 @@ struct pef_sequence {
         visitor.visit(m_upper_bounds);
         visitor.visit(m_data);
         visitor.visit(m_log_partition_size);
+        read_header();
+    }
+
+private:
+    // End positions of the partitions of the n values from begin that
+    // minimize their space. Chunks of optimal_partition_chunk values are
+    // partitioned concurrently, so the partitioning is optimal within each
+    // chunk.
+    template <typename Iterator>
+    static std::vector<uint64_t> optimal_partitions(Iterator begin,
+                                                    uint64_t n) {
+        pef_parameters params;
+        auto cost = [&params](uint64_t universe, uint64_t size,
+                              uint64_t first, bool distinct) {
+            return indexed_sequence::bitsize(params, universe, size, first,
+                                             distinct) +
+                   global::partition_fixed_cost;
+        };
+
+        uint64_t chunks = util::ceil_div(n, global::optimal_partition_chunk);
+        std::vector<std::vector<uint64_t>> chunk_ends(chunks);
+        auto partition = [&](uint64_t c) {
+            uint64_t c_begin = c * global::optimal_partition_chunk;
+            uint64_t c_end =
+                std::min(c_begin + global::optimal_partition_chunk, n);
+            uint64_t base = c_begin ? *(begin + (c_begin - 1)) : *begin;
+            optimal_partition opt(begin + c_begin, base, c_end - c_begin,
+                                  cost, global::eps1, global::eps2);
+            for (auto end : opt.partition) {
+                chunk_ends[c].push_back(c_begin + end);
+            }
+        };
+
+        // the chunks are taken in turn by as many tasks as there are cores
+        uint64_t tasks = std::min<uint64_t>(
+            std::max<unsigned>(std::thread::hardware_concurrency(), 1),
+            chunks);
+        if (tasks == 1) {
+            for (uint64_t c = 0; c != chunks; ++c) partition(c);
+        } else {
+            std::vector<std::future<void>> futures;
+            for (uint64_t t = 0; t != tasks; ++t) {
+                futures.push_back(std::async(std::launch::async, [&, t]() {
+                    for (uint64_t c = t; c < chunks; c += tasks) partition(c);
+                }));
+            }
+            for (auto& f : futures) f.get();
+        }
 
-        if (m_size) {
-            m_it = begin();
+        std::vector<uint64_t> ends;
+        for (auto const& e : chunk_ends) {
+            ends.insert(ends.end(), e.begin(), e.end());
+        }
+        return ends;
+    }
+
+    // Encode partitions [p_begin, p_end), ending at the given positions,
+    // into bvb, recording the (local) endpoint, the type and the upper
+    // bound of each partition.
+    template <typename Iterator>
+    static void write_partitions(Iterator begin,
+                                 std::vector<uint64_t> const& ends,
+                                 uint64_t p_begin, uint64_t p_end,
+                                 rdf::bit_vector_builder& bvb,
+                                 std::vector<uint64_t>& endpoints,
+                                 std::vector<uint64_t>& types,
+                                 std::vector<uint64_t>& upper_bounds) {
+        pef_parameters params;
+        std::vector<uint64_t> cur_partition;
+
+        uint64_t cur_i = p_begin ? ends[p_begin - 1] : 0;
+        Iterator it = begin + cur_i;
+        uint64_t cur_base = cur_i ? *(it - 1) : *begin;
+
+        for (uint64_t p = p_begin; p < p_end; ++p) {
+            cur_partition.clear();
+            uint64_t value = 0;
+            for (; cur_i < ends[p]; ++cur_i, ++it) {
+                value = *it;
+                cur_partition.push_back(value - cur_base);
+            }
+
+            assert(cur_partition.size() > 0);
+
+            uint64_t upper_bound = value;
+            auto type = indexed_sequence::best_type(
+                cur_partition.begin(), cur_partition.back() + 1,
+                cur_partition.size(), params);
+            endpoints.push_back(bvb.size());
+            types.push_back(type);
+            indexed_sequence::write(bvb, cur_partition.begin(),
+                                    cur_partition.back() + 1,
+                                    cur_partition.size(), params, type);
+            upper_bounds.push_back(upper_bound);
+            cur_base = upper_bound;
         }
     }
 
-private:
     uint64_t m_size;
     uint64_t m_universe;
     uint64_t m_partitions;
     pef_parameters m_params;
     rdf::compact_vector m_upper_bounds;
     rdf::bit_vector m_data;
-    uint8_t m_log_partition_size;
-    iterator m_it;
-
-    uint64_t previous_range_upperbound(range const& r) {
-        uint64_t x = 0;
-        if (LIKELY(r.begin)) {
-            x = access(r.begin - 1);
+    uint8_t m_log_partition_size;  // 0 with variable partitions
+
+    // Decoded from m_data when the sequence is built or loaded (not
+    // stored), so that creating an iterator does not read the header.
+    uint64_t m_endpoints_offset;  // with many partitions
+    uint64_t m_endpoint_bits;
+    uint64_t m_ends_offset;       // with variable-length partitions
+    uint64_t m_sequences_offset;  // or the offset of the single partition
+    uint64_t m_base;              // of the single partition
+    uint64_t m_upper_bound;
+    indexed_sequence::index_type m_type;
+
+    void read_header() {
+        if (!m_size) return;
+        rdf::bits_iterator<rdf::bit_vector> it(m_data);
+        if (m_partitions == 1) {
+            uint64_t universe_bits = util::ceil_log2(m_universe + 1);
+            m_base = it.get_bits(universe_bits);
+            m_upper_bound = 0;
+            if (m_size > 1) {
+                uint64_t universe_delta = read_delta(it);
+                m_upper_bound = universe_delta ? universe_delta
+                                               : (m_universe - m_base - 1);
+            }
+            m_type = indexed_sequence::index_type(
+                it.get_bits(indexed_sequence::type_bits));
+            m_sequences_offset = it.position();
+        } else {
+            m_endpoint_bits = read_gamma(it) + indexed_sequence::type_bits;
+            m_endpoints_offset = it.position();
+            m_ends_offset =
+                m_endpoints_offset + m_endpoint_bits * m_partitions;
+            m_sequences_offset = m_ends_offset;
+            if (Partitions::variable) {
+                m_sequences_offset +=
+                    compact_ef::bitsize(m_params, m_size, m_partitions - 1);
+            }
         }
-        return x;
     }
 };
+
+typedef basic_pef_sequence<uniform_partitions> pef_sequence;
+// with variable-length partitions that minimize the space
+typedef basic_pef_sequence<variable_partitions> pef_opt_sequence;
+
 }  // namespace pef
 
+namespace search {
+
+// One cursor is moved across the ranges, so that the partition holding the
+// next range is usually the current one, instead of building a cursor and
+// locating its partition for every range. For both partition layouts.
+template <typename Partitions>
+struct range_finder<pef::basic_pef_sequence<Partitions>> {
+    typedef pef::basic_pef_sequence<Partitions> sequence_type;
+
+    range_finder() {}
+
+    range_finder(sequence_type const& sequence, uint64_t begin)
+        : m_it(sequence, {0, 0}, begin), m_begin(0), m_prev_upper_bound(0) {}
+
+    uint64_t find(range const& r, uint64_t id) {
+        assert(r.end > r.begin);
+        id += prev_upper_bound(r);
+        auto pos_value = m_it.move(r.begin);
+        if (pos_value.second < id) pos_value = m_it.next_geq(id, r);
+        if (pos_value.second == id and pos_value.first < r.end) {
+            return pos_value.first;
+        }
+        return rdf::global::not_found;
+    }
+
+    // A copy of the cursor, moved to pos in r: after find(r, id), pos is
+    // usually in the partition the cursor is on, so that no partition is
+    // located again.
+    typename sequence_type::iterator at(range const& r, uint64_t pos) {
+        auto it = m_it;
+        it.m_prev_range_upper_bound = it.m_last = prev_upper_bound(r);
+        it.move(pos);
+        return it;
+    }
+
+private:
+    typename sequence_type::iterator m_it;
+    uint64_t m_begin;  // of the range of m_prev_upper_bound, if not 0
+    uint64_t m_prev_upper_bound;
+
+    // the value before r.begin, read once per range from the partition
+    // of r.begin
+    uint64_t prev_upper_bound(range const& r) {
+        if (r.begin != m_begin) {
+            m_begin = r.begin;
+            m_it.move(r.begin);
+            m_prev_upper_bound = m_it.prev_value();
+        }
+        return m_prev_upper_bound;
+    }
+};
+
+}  // namespace search
+
 }  // namespace rdf
\ No newline at end of file
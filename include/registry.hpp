@@ -0,0 +1,221 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+#include "serialization.hpp"
+
+namespace rdf {
+
+/*
+    Registry of the index types. Each type has a name, that selects it on
+    the command line and identifies it in the header of a saved index, so
+    that tools load a file with the type it was saved with.
+*/
+template <typename Index>
+struct index_traits;
+
+template <>
+struct index_traits<compact_3t> {
+    static char const* name() {
+        return "compact_3t";
+    }
+};
+
+template <>
+struct index_traits<ef_3t> {
+    static char const* name() {
+        return "ef_3t";
+    }
+};
+
+template <>
+struct index_traits<pef_3t> {
+    static char const* name() {
+        return "pef_3t";
+    }
+};
+
+template <>
+struct index_traits<pef_opt_3t> {
+    static char const* name() {
+        return "pef_opt_3t";
+    }
+};
+
+template <>
+struct index_traits<vb_3t> {
+    static char const* name() {
+        return "vb_3t";
+    }
+};
+
+template <>
+struct index_traits<svb_3t> {
+    static char const* name() {
+        return "svb_3t";
+    }
+};
+
+template <>
+struct index_traits<auto_3t> {
+    static char const* name() {
+        return "auto_3t";
+    }
+};
+
+template <>
+struct index_traits<pef_r_3t> {
+    static char const* name() {
+        return "pef_r_3t";
+    }
+};
+
+template <>
+struct index_traits<pef_2to> {
+    static char const* name() {
+        return "pef_2to";
+    }
+};
+
+template <>
+struct index_traits<pef_2tp> {
+    static char const* name() {
+        return "pef_2tp";
+    }
+};
+
+template <>
+struct index_traits<vb_2tp> {
+    static char const* name() {
+        return "vb_2tp";
+    }
+};
+
+template <typename... Indexes>
+struct index_list {};
+
+typedef index_list<compact_3t, ef_3t, pef_3t, pef_opt_3t, vb_3t, svb_3t,
+                   auto_3t, pef_r_3t>
+    index_3t_types;
+
+typedef index_list<compact_3t, ef_3t, pef_3t, pef_opt_3t, vb_3t, svb_3t,
+                   auto_3t, pef_r_3t, pef_2to, pef_2tp, vb_2tp>
+    index_types;
+
+template <typename Index>
+struct index_tag {
+    typedef Index type;
+};
+
+namespace detail {
+template <typename Func>
+bool dispatch(std::string const&, Func&, index_list<>) {
+    return false;
+}
+
+template <typename Func, typename Index, typename... Indexes>
+bool dispatch(std::string const& type, Func& f,
+              index_list<Index, Indexes...>) {
+    if (type == index_traits<Index>::name()) {
+        f(index_tag<Index>());
+        return true;
+    }
+    return dispatch(type, f, index_list<Indexes...>());
+}
+}  // namespace detail
+
+// Calls f(index_tag<Index>()) with the type of Types named type.
+// Returns false if there is no such type.
+template <typename Types = index_types, typename Func>
+bool dispatch(std::string const& type, Func f) {
+    return detail::dispatch(type, f, Types());
+}
+
+// Precedes the data structure in a saved index.
+struct index_header {
+    static const uint64_t magic_number = 0x7864696664727472;  // "rtrdfidx"
+    static const uint64_t format_version = 3;
+
+    index_header() : magic(magic_number), version(format_version) {}
+
+    index_header(std::string const& type)
+        : magic(magic_number)
+        , version(format_version)
+        , type(type.begin(), type.end()) {}
+
+    std::string type_name() const {
+        return std::string(type.begin(), type.end());
+    }
+
+    // throws unless the header is of an index of the given type
+    void check(std::string const& expected) const {
+        if (type_name() != expected) {
+            throw std::runtime_error("Index file of type '" + type_name() +
+                                     "', expected '" + expected + "'.");
+        }
+    }
+
+    // the format is checked before the type is read, so that a file that
+    // is not an index fails early
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(magic);
+        visitor.visit(version);
+        if (magic != magic_number) {
+            throw std::runtime_error("Not an index file.");
+        }
+        if (version != format_version) {
+            throw std::runtime_error(
+                "Index file of format version " + std::to_string(version) +
+                ", expected " + std::to_string(format_version) + ".");
+        }
+        visitor.visit(type);
+    }
+
+    uint64_t magic;
+    uint64_t version;
+    std::vector<char> type;
+};
+
+// the type of the index saved to filename
+inline std::string index_type(char const* filename) {
+    loader l(filename);
+    index_header header;
+    l.visit(header);
+    return header.type_name();
+}
+
+template <typename Index>
+size_t save_index(Index& index, char const* filename) {
+    saver s(filename);
+    index_header header(index_traits<Index>::name());
+    s.visit(header);
+    s.visit(index);
+    return s.bytes();
+}
+
+template <typename Index>
+size_t load_index(Index& index, char const* filename) {
+    loader l(filename);
+    index_header header;
+    l.visit(header);
+    header.check(index_traits<Index>::name());
+    l.visit(index);
+    return l.bytes();
+}
+
+// The file must stay mapped for as long as index is used.
+template <typename Index>
+size_t map_index(Index& index, mapped_file const& file) {
+    mmap_loader l(file);
+    index_header header;
+    l.visit(header);
+    header.check(index_traits<Index>::name());
+    l.visit(index);
+    return l.bytes();
+}
+
+}  // namespace rdf
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "../external/essentials/include/essentials.hpp"
+#include "mappable_vector.hpp"
+#include "mapped_file.hpp"
+
+namespace rdf {
+
+/*
+    On-disk layout of an index. Data structures are written in the order
+    of their visit() methods: PODs as raw bytes; arrays as their size
+    followed by their elements, starting at an 8-byte aligned offset from
+    the beginning of the file. The file is padded with trailing zeros, so
+    that word-sized reads past the end of the last array stay in bounds.
+    A saved file can either be loaded into heap memory, or memory-mapped
+    with arrays becoming views over the mapped file.
+*/
+namespace serialization {
+static const uint64_t alignment = 8;
+
+inline uint64_t padding(uint64_t offset) {
+    return (alignment - offset % alignment) % alignment;
+}
+}  // namespace serialization
+
+struct saver {
+    saver(char const* filename)
+        : m_os(filename, std::ios::binary), m_bytes(0) {
+        if (!m_os.good()) {
+            throw std::runtime_error("Error in opening binary file.");
+        }
+    }
+
+    ~saver() {
+        pad(serialization::alignment);
+    }
+
+    template <typename T>
+    void visit(T& val) {
+        visit_impl(val, essentials::detail::is_pod_t<T>());
+    }
+
+    template <typename T>
+    void visit(mappable_vector<T>& vec) {
+        write_array(vec.data(), vec.size());
+    }
+
+    template <typename T>
+    void visit(std::vector<T>& vec) {
+        write_array(vec.data(), vec.size());
+    }
+
+    size_t bytes() const {
+        return m_bytes;
+    }
+
+private:
+    std::ofstream m_os;
+    size_t m_bytes;
+
+    template <typename T>
+    void visit_impl(T& val, std::true_type) {
+        write(&val, sizeof(T));
+    }
+
+    template <typename T>
+    void visit_impl(T& val, std::false_type) {
+        val.visit(*this);
+    }
+
+    template <typename T>
+    void write_array(T const* data, size_t n) {
+        static_assert(std::is_pod<T>::value, "array of non-POD types");
+        write(&n, sizeof(n));
+        pad(serialization::padding(m_bytes));
+        write(data, n * sizeof(T));
+    }
+
+    void write(void const* data, size_t n) {
+        m_os.write(reinterpret_cast<char const*>(data), n);
+        m_bytes += n;
+    }
+
+    void pad(size_t n) {
+        static const char zeros[serialization::alignment] = {0};
+        write(zeros, n);
+    }
+};
+
+struct loader {
+    loader(char const* filename)
+        : m_is(filename, std::ios::binary), m_bytes(0) {
+        if (!m_is.good()) {
+            throw std::runtime_error("Error in opening binary file.");
+        }
+    }
+
+    template <typename T>
+    void visit(T& val) {
+        visit_impl(val, essentials::detail::is_pod_t<T>());
+    }
+
+    template <typename T>
+    void visit(mappable_vector<T>& vec) {
+        std::vector<T> tmp;
+        visit(tmp);
+        vec.steal(tmp);
+    }
+
+    template <typename T>
+    void visit(std::vector<T>& vec) {
+        size_t n;
+        read(&n, sizeof(n));
+        skip(serialization::padding(m_bytes));
+        vec.resize(n);
+        read(vec.data(), n * sizeof(T));
+    }
+
+    size_t bytes() const {
+        return m_bytes;
+    }
+
+private:
+    std::ifstream m_is;
+    size_t m_bytes;
+
+    template <typename T>
+    void visit_impl(T& val, std::true_type) {
+        read(&val, sizeof(T));
+    }
+
+    template <typename T>
+    void visit_impl(T& val, std::false_type) {
+        val.visit(*this);
+    }
+
+    void read(void* data, size_t n) {
+        if (!m_is.read(reinterpret_cast<char*>(data), n)) {
+            throw std::runtime_error("Unexpected end of binary file.");
+        }
+        m_bytes += n;
+    }
+
+    void skip(size_t n) {
+        m_is.ignore(n);
+        m_bytes += n;
+    }
+};
+
+// Zero-copy loader: arrays become views over the mapped file.
+struct mmap_loader {
+    mmap_loader(mapped_file const& file)
+        : m_begin(file.data()), m_cur(file.data()), m_end(file.data()) {
+        m_end += file.size();
+    }
+
+    template <typename T>
+    void visit(T& val) {
+        visit_impl(val, essentials::detail::is_pod_t<T>());
+    }
+
+    template <typename T>
+    void visit(mappable_vector<T>& vec) {
+        size_t n;
+        read(&n, sizeof(n));
+        advance(serialization::padding(m_cur - m_begin));
+        vec.view(reinterpret_cast<T const*>(m_cur), n);
+        advance(n * sizeof(T));
+    }
+
+    template <typename T>
+    void visit(std::vector<T>& vec) {
+        size_t n;
+        read(&n, sizeof(n));
+        advance(serialization::padding(m_cur - m_begin));
+        T const* data = reinterpret_cast<T const*>(m_cur);
+        advance(n * sizeof(T));
+        vec.assign(data, data + n);
+    }
+
+    size_t bytes() const {
+        return m_cur - m_begin;
+    }
+
+private:
+    uint8_t const* m_begin;
+    uint8_t const* m_cur;
+    uint8_t const* m_end;
+
+    template <typename T>
+    void visit_impl(T& val, std::true_type) {
+        read(&val, sizeof(T));
+    }
+
+    template <typename T>
+    void visit_impl(T& val, std::false_type) {
+        val.visit(*this);
+    }
+
+    void advance(size_t n) {
+        if (n > size_t(m_end - m_cur)) {
+            throw std::runtime_error("Unexpected end of binary file.");
+        }
+        m_cur += n;
+    }
+
+    void read(void* data, size_t n) {
+        uint8_t const* src = m_cur;
+        advance(n);
+        std::memcpy(data, src, n);
+    }
+};
+
+template <typename T>
+size_t save(T& data, char const* filename) {
+    saver s(filename);
+    s.visit(data);
+    return s.bytes();
+}
+
+template <typename T>
+size_t load(T& data, char const* filename) {
+    loader l(filename);
+    l.visit(data);
+    return l.bytes();
+}
+
+// The file must stay mapped for as long as data is used.
+template <typename T>
+size_t map(T& data, mapped_file const& file) {
+    mmap_loader l(file);
+    l.visit(data);
+    return l.bytes();
+}
+
+}  // namespace rdf
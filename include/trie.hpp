@@ -1,7 +1,10 @@
 #pragma once
 
+#include <type_traits>
+
 #include "util_types.hpp"
 #include "parameters.hpp"
+#include "triplets_reader.hpp"
 #include "util.hpp"
 
 namespace rdf {
@@ -11,9 +14,10 @@ struct trie {
     typedef Levels levels_type;
 
     struct builder {
-        builder() {}
+        builder() : m_perm(0) {}
 
-        builder(int perm, parameters const& params) : m_perm(perm) {
+        builder(int perm, parameters const& params)
+            : m_perm(perm), m_params(params) {
             assert(perm > 0);
 
             resize(m_first.pointers,
@@ -31,17 +35,19 @@ struct trie {
                    params.num_types(perm, level_type::third));
         }
 
+        // Read the permutation file once: build the first and second levels
+        // and buffer the nodes of the third level. These are compressed
+        // right away, unless they have to be mapped (see build_third_level).
         void build_first_and_second_level(trie<Mapper, Levels>& t,
                                           parameters const& params) {
             std::string filename(std::string(params.collection_basename) + "." +
                                  suffix(m_perm));
-            std::ifstream input(filename.c_str(), std::ios_base::in);
-            triplets_iterator input_it(input, m_perm);
+            triplets_reader input_it(filename, m_perm);
 
             uint64_t pointer_first = 0;
             uint64_t pointer_second = 0;
             triplet prev;
-            while (input) {
+            while (input_it.has_next()) {
                 triplet curr = *input_it;
 
                 if (curr.first != prev.first) {
@@ -54,48 +60,52 @@ struct trie {
                     m_second.nodes.push_back(curr.second);
                 }
 
+                m_third.nodes.push_back(curr.third);
+
                 ++pointer_second;
                 prev = curr;
 
                 ++input_it;
             }
 
-            input.close();
             m_first.pointers.push_back(pointer_first);
             m_second.pointers.push_back(pointer_second);
 
             util::logger("compressing...");
             m_first.build_pointers(t.first.pointers, m_first.pointers);
             m_second.build_nodes(t.second.nodes, m_second.nodes,
-                                 m_first.pointers);
+                                 m_first.pointers, m_params);
             m_second.build_pointers(t.second.pointers, m_second.pointers);
+            if (!needs_mapping) {
+                m_third.build_nodes(t.third.nodes, m_third.nodes,
+                                    m_second.pointers, m_params);
+            }
             util::logger("DONE");
         }
 
-        void build_third_level(trie<Mapper, Levels>& t,
-                               parameters const& params) {
-            std::ifstream input(
-                std::string(params.collection_basename) + "." + suffix(m_perm),
-                std::ios_base::in);
-            triplets_iterator input_it(input, m_perm);
-
-            while (input) {
-                triplet curr = *input_it;
-                uint64_t node = mapper.map(curr);
-                m_third.nodes.push_back(node);
-                ++input_it;
+        // Map the buffered nodes of the third level and compress them.
+        // The mapper must have been initialized with a complete trie.
+        void build_third_level(trie<Mapper, Levels>& t) {
+            if (needs_mapping) {
+                util::logger("mapping...");
+                map_third_level(t);
+                util::logger("compressing...");
+                m_third.build_nodes(t.third.nodes, m_third.nodes,
+                                    m_second.pointers, m_params);
+                util::logger("DONE");
             }
-
-            util::logger("compressing");
-            m_third.build_nodes(t.third.nodes, m_third.nodes,
-                                m_second.pointers);
-            util::logger("DONE");
             t.m_perm = m_perm;
             builder().swap(*this);
         }
 
+        void build(trie<Mapper, Levels>& t, parameters const& params) {
+            build_first_and_second_level(t, params);
+            build_third_level(t);
+        }
+
         void swap(builder& other) {
             std::swap(m_perm, other.m_perm);
+            std::swap(m_params, other.m_params);
             m_first.swap(other.m_first);
             m_second.swap(other.m_second);
             m_third.swap(other.m_third);
@@ -104,10 +114,40 @@ struct trie {
         Mapper mapper;
 
     private:
+        static const bool needs_mapping =
+            !std::is_void<typename Mapper::mapper_index_type>::value;
+
         int m_perm;
+        parameters m_params;
         typename Levels::first::builder m_first;
         typename Levels::second::builder m_second;
         typename Levels::third::builder m_third;
+
+        // replace each buffered node in place with its mapped value:
+        // the parent of the nodes in a range is given by the (already built)
+        // second level of t
+        void map_third_level(trie<Mapper, Levels>& t) {
+            uint64_t pairs = t.second.size();
+            typename Levels::second::iterator second_it(
+                t.second.nodes.begin(), t.first.pointers.begin());
+            auto pointers_it = m_second.pointers.begin();
+            auto nodes_it = m_third.nodes.begin();
+            uint64_t end = *pointers_it;
+            ++pointers_it;
+            triplet curr;
+            curr.first = 0;
+            for (uint64_t i = 0; i != pairs; ++i) {
+                uint64_t begin = end;
+                end = *pointers_it;
+                ++pointers_it;
+                curr.second = *second_it;
+                for (uint64_t j = begin; j != end; ++j, ++nodes_it) {
+                    curr.third = *nodes_it;
+                    m_third.nodes.set(j, mapper.map(curr));
+                }
+                if (i + 1 != pairs and ++second_it) ++curr.first;
+            }
+        }
     };
 
     trie()
@@ -116,16 +156,22 @@ struct trie {
         , third(level_type::third) {}
 
     struct iterator;
-    iterator select_all();
-    iterator select(triplet const& t);
-    uint64_t is_member(triplet const& t);
+    iterator select_all() const;
+    iterator select(triplet const& t) const;
+    uint64_t is_member(triplet const& t) const;
+    void is_member(triplet const* queries, uint64_t n, uint64_t* out) const;
+
+    /* number of matching triples */
+    uint64_t count(triplet const& t) const;
+    uint64_t count_so(triplet const& t) const;
+
+    /* seekable iterator over the levels, for worst-case optimal joins */
+    struct cursor;
+    cursor open_cursor() const;
 
     /* specializations */
     struct iterator_so;
-    struct iterator_po;
-    iterator_so select_so(triplet const& t);
-    iterator_po select_p(triplet const& t);
-    iterator_po select_o(triplet const& t);
+    iterator_so select_so(triplet const& t) const;
     /*******************/
 
     void print_stats(essentials::json_lines& stats, size_t bytes);
@@ -142,6 +188,13 @@ struct trie {
         return third.size();
     }
 
+    // number of children of the first-level node i
+    uint64_t children(uint64_t i) const {
+        if (i >= first.size()) return 0;
+        range r = first.pointers[i];
+        return r.end - r.begin;
+    }
+
     size_t bytes() const {
         return first.bytes() + second.bytes() + third.bytes() + sizeof(m_perm);
     }
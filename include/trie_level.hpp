@@ -1,6 +1,7 @@
 #pragma once
 
 #include "compact_vector.hpp"
+#include "parameters.hpp"
 #include "util_types.hpp"
 #include "util.hpp"
 
@@ -10,6 +11,15 @@ void resize(compact_vector::builder& cvb, uint64_t n, uint64_t max) {
     cvb.resize(n, util::ceil_log2(max + 1));
 }
 
+// Build a sequence of nodes: the codecs taking options from the parameters
+// overload this (see auto_sequence.hpp).
+template <typename Nodes>
+void build_sequence(Nodes& nodes, compact_vector::builder& from,
+                    compact_vector::builder const& pointers,
+                    parameters const& /* params */) {
+    nodes.build(from, pointers);
+}
+
 template <typename Nodes, typename Pointers>
 struct trie_level {
     typedef Nodes nodes_type;
@@ -19,8 +29,9 @@ struct trie_level {
         builder() {}
 
         void build_nodes(Nodes& nodes, compact_vector::builder& from,
-                         compact_vector::builder const& pointers) {
-            nodes.build(from, pointers);
+                         compact_vector::builder const& pointers,
+                         parameters const& params) {
+            build_sequence(nodes, from, pointers, params);
         }
 
         void build_pointers(Pointers& pointers,
@@ -68,6 +79,10 @@ struct trie_level {
             return {m_begin, m_end};
         }
 
+        uint64_t position() const {
+            return m_begin + m_pos_in_range;
+        }
+
         void next_pointer() {
             m_begin = m_end;
             m_end = m_pointers_it.next();
@@ -88,6 +103,36 @@ struct trie_level {
             return m_switch_range;
         }
 
+        // Write the next n nodes to out, moving onto the last of them, and
+        // return the number of ranges entered on the way. begins[i] is set
+        // to the number of ranges entered right before the i-th node.
+        uint64_t next_values(uint64_t* out, uint64_t n, uint32_t* begins) {
+            std::fill(begins, begins + n, 0);
+            uint64_t pos = position();
+            uint64_t ranges = 0;
+            while (m_end <= pos + n) {
+                ++begins[m_end - pos - 1];
+                next_pointer();
+                ++ranges;
+            }
+            m_nodes_it.next_values(out, n, begins);
+            m_pos_in_range = pos + n - m_begin;
+            m_node = out[n - 1];
+            return ranges;
+        }
+
+        // Move to the first node >= value of the current range and return
+        // true. If there is none, stop on the last node of the range and
+        // return false.
+        bool skip_to(uint64_t value) {
+            if (m_node >= value) return true;
+            uint64_t pos = m_nodes_it.next_geq(pointer(), value);
+            bool found = pos != m_end;
+            m_pos_in_range = (found ? pos : m_end - 1) - m_begin;
+            m_node = m_nodes_it.value();
+            return found;
+        }
+
     private:
         uint64_t m_range_len;
         uint64_t m_pos_in_range;
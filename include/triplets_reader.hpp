@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "util_types.hpp"
+
+namespace rdf {
+
+/*
+    Binary format for a permutation file.
+    A 24-byte header, followed by num_triplets triples written as
+    little-endian integers of 'width' bytes each (4 or 8).
+    Triples keep the same (s,p,o) column order of the text format,
+    so a binary file is just a packed copy of the text one.
+*/
+namespace binary_triplets {
+
+static const char magic[8] = {'R', 'D', 'F', 'T', 'R', 'I', 'P', 'S'};
+static const uint32_t version = 1;
+
+struct header {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;  // in bytes
+    uint64_t num_triplets;
+};
+static_assert(sizeof(header) == 24, "unexpected header size");
+
+inline bool is_binary(std::string const& filename) {
+    std::ifstream in(filename.c_str(), std::ios_base::binary);
+    char buf[sizeof(magic)];
+    if (!in.read(buf, sizeof(magic))) return false;
+    return std::memcmp(buf, magic, sizeof(magic)) == 0;
+}
+
+// convert a text permutation file into the binary format
+inline uint64_t convert(std::string const& input_filename,
+                        std::string const& output_filename) {
+    uint64_t max = 0;
+    uint64_t n = 0;
+    {
+        std::ifstream input(input_filename.c_str(), std::ios_base::in);
+        triplets_iterator it(input);
+        while (it.has_next()) {
+            triplet t = *it;
+            max = std::max({max, t.first, t.second, t.third});
+            ++n;
+            ++it;
+        }
+    }
+
+    header h;
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.width = (max >> 32) ? 8 : 4;
+    h.num_triplets = n;
+
+    std::ofstream out(output_filename.c_str(), std::ios_base::binary);
+    if (!out.good()) {
+        throw std::runtime_error("Error in opening file '" + output_filename +
+                                 "'.");
+    }
+    out.write(reinterpret_cast<char const*>(&h), sizeof(h));
+
+    std::ifstream input(input_filename.c_str(), std::ios_base::in);
+    triplets_iterator it(input);
+    std::vector<uint8_t> buf;
+    static const uint64_t buf_triplets = 1 << 16;
+    buf.reserve(buf_triplets * 3 * h.width);
+    while (it.has_next()) {
+        triplet t = *it;
+        uint64_t const* x = &t.first;
+        for (int i = 0; i != 3; ++i) {
+            uint8_t const* b = reinterpret_cast<uint8_t const*>(x + i);
+            buf.insert(buf.end(), b, b + h.width);  // little-endian
+        }
+        if (buf.size() == buf.capacity()) {
+            out.write(reinterpret_cast<char const*>(buf.data()), buf.size());
+            buf.clear();
+        }
+        ++it;
+    }
+    out.write(reinterpret_cast<char const*>(buf.data()), buf.size());
+    out.close();
+    return n;
+}
+
+}  // namespace binary_triplets
+
+/*
+    Iterates over the triples of a permutation file, either in
+    text or binary format. The format is detected from the file header.
+    Binary files are memory-mapped and decoded without copies.
+*/
+struct triplets_reader {
+    triplets_reader(std::string const& filename,
+                    int perm = permutation_type::spo)
+        : m_perm(perm)
+        , m_binary(binary_triplets::is_binary(filename))
+        , m_good(true)
+        , m_cur(nullptr)
+        , m_end(nullptr)
+        , m_width(0) {
+        if (m_binary) {
+            m_file.open(filename.c_str(), MADV_SEQUENTIAL);
+            binary_triplets::header h;
+            if (m_file.size() < sizeof(h)) {
+                throw std::runtime_error("File '" + filename +
+                                         "' is malformed.");
+            }
+            std::memcpy(&h, m_file.data(), sizeof(h));
+            m_width = h.width;
+            if (h.version != binary_triplets::version or
+                (m_width != 4 and m_width != 8) or
+                m_file.size() !=
+                    sizeof(h) + h.num_triplets * 3 * uint64_t(m_width)) {
+                throw std::runtime_error("File '" + filename +
+                                         "' is malformed.");
+            }
+            m_cur = m_file.data() + sizeof(h);
+            m_end = m_cur + h.num_triplets * 3 * m_width;
+        } else {
+            m_in.open(filename.c_str(), std::ios_base::in);
+            if (!m_in.good()) {
+                throw std::runtime_error(
+                    "Error in opening file, it may not exist or be "
+                    "malformed.");
+            }
+        }
+        read_next();
+    }
+
+    bool has_next() const {
+        return m_good;
+    }
+
+    void operator++() {
+        read_next();
+    }
+
+    triplet operator*() const {
+        return m_val;
+    }
+
+    bool binary() const {
+        return m_binary;
+    }
+
+private:
+    int m_perm;
+    bool m_binary;
+    bool m_good;
+    triplet m_val;
+    std::ifstream m_in;
+    mapped_file m_file;
+    uint8_t const* m_cur;
+    uint8_t const* m_end;
+    uint32_t m_width;
+
+    inline uint64_t read_int() {
+        uint64_t x;
+        if (m_width == 4) {
+            uint32_t y;
+            std::memcpy(&y, m_cur, 4);  // little-endian
+            x = y;
+        } else {
+            std::memcpy(&x, m_cur, 8);
+        }
+        m_cur += m_width;
+        return x;
+    }
+
+    inline void read_next() {
+        uint64_t s, p, o;
+        if (m_binary) {
+            if (m_cur == m_end) {
+                m_good = false;
+                return;
+            }
+            s = read_int();
+            p = read_int();
+            o = read_int();
+        } else {
+            if (!(m_in >> s >> p >> o)) {
+                m_good = false;
+                return;
+            }
+        }
+        assign(m_val, s, p, o, m_perm);
+    }
+};
+
+}  // namespace rdf
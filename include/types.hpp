@@ -11,7 +11,12 @@
 #include "ef/ef_sequence.hpp"
 #include "pef/pef_sequence.hpp"
 #include "vb/vb.hpp"
+#include "vb/streamvbyte.hpp"
+#include "auto_sequence.hpp"
 #include "algorithms.hpp"
+#include "bgp.hpp"
+#include "leapfrog.hpp"
+#include "serialization.hpp"
 #include "util_types.hpp"
 
 namespace rdf {
@@ -58,6 +63,23 @@ typedef index_3t<ef_t, ef_t, ef_t> ef_3t;
 // typedef index_3t<pef_t, pef_t, pef_t> pef_3t;
 typedef index_3t<pef_compact_t, pef_t, pef_t> pef_3t;
 
+// as pef_3t, with optimally partitioned sequences
+struct pef_opt_levels {
+    typedef trie_level<pef::pef_opt_sequence, ef::ef_sequence> first;
+    typedef trie_level<pef::pef_opt_sequence, ef::ef_sequence> second;
+    typedef trie_level<pef::pef_opt_sequence, ef::ef_sequence> third;
+};
+
+struct pef_opt_compact_levels {
+    typedef trie_level<pef::pef_opt_sequence, ef::ef_sequence> first;
+    typedef trie_level<pef::pef_opt_sequence, ef::ef_sequence> second;
+    typedef trie_level<compact_vector, ef::ef_sequence> third;
+};
+
+typedef trie<identity_mapper, pef_opt_levels> pef_opt_t;
+typedef trie<identity_mapper, pef_opt_compact_levels> pef_opt_compact_t;
+typedef index_3t<pef_opt_compact_t, pef_opt_t, pef_opt_t> pef_opt_3t;
+
 typedef index_2to<pef_compact_t, pef_t> pef_2to;
 typedef index_2tp<pef_compact_t, pef_t> pef_2tp;
 
@@ -70,8 +92,8 @@ typedef index_3t<pef_compact_t, pef_rt2, pef_compact2_t> pef_r_3t;
 
 typedef block_sequence<
     // vb::vbyte_block
-    vb::maskedvbyte_block  // SIMD
-    >
+    vb::maskedvbyte_block,  // SIMD
+    vb::vbyte64_block>
     vb_sequence;
 
 struct vb_levels {
@@ -83,4 +105,25 @@ typedef trie<identity_mapper, vb_levels> vb_t;
 typedef index_3t<vb_t, vb_t, vb_t> vb_3t;
 typedef index_2tp<pef_compact_t, vb_t> vb_2tp;
 
+// as vb_3t, with Stream VByte blocks
+typedef block_sequence<vb::streamvbyte_block, vb::streamvbyte64_block>
+    svb_sequence;
+
+struct svb_levels {
+    typedef trie_level<svb_sequence, ef::ef_sequence> first;
+    typedef trie_level<svb_sequence, ef::ef_sequence> second;
+    typedef trie_level<svb_sequence, ef::ef_sequence> third;
+};
+typedef trie<identity_mapper, svb_levels> svb_t;
+typedef index_3t<svb_t, svb_t, svb_t> svb_3t;
+
+// the codec of every level is chosen at building time
+struct auto_levels {
+    typedef trie_level<auto_sequence, ef::ef_sequence> first;
+    typedef trie_level<auto_sequence, ef::ef_sequence> second;
+    typedef trie_level<auto_sequence, ef::ef_sequence> third;
+};
+typedef trie<identity_mapper, auto_levels> auto_t;
+typedef index_3t<auto_t, auto_t, auto_t> auto_3t;
+
 }  // namespace rdf
@@ -43,16 +43,24 @@ void require_equal(T const& t, S const& s) {
     }
 }
 
+// Return the position of id in [lo, hi], or global::not_found.
+// Sequences with a faster scan overload this function.
+template <typename S>
+inline uint64_t linear_search(S const& sequence, uint64_t id, uint64_t lo,
+                              uint64_t hi) {
+    auto it = sequence.at(lo);
+    for (uint64_t pos = lo; pos <= hi; ++pos, ++it) {
+        if (*it == id) return pos;
+    }
+    return global::not_found;
+}
+
 template <typename S>
 inline uint64_t scan_binary_search(S const& sequence, uint64_t id, uint64_t lo,
                                    uint64_t hi) {
     while (lo <= hi) {
         if (hi - lo <= global::linear_scan_threshold) {
-            auto it = sequence.at(lo);
-            for (uint64_t pos = lo; pos <= hi; ++pos, ++it) {
-                if (*it == id) return pos;
-            }
-            return global::not_found;
+            return linear_search(sequence, id, lo, hi);
         }
 
         uint64_t pos = lo + ((hi - lo) >> 1);
@@ -69,6 +77,159 @@ inline uint64_t scan_binary_search(S const& sequence, uint64_t id, uint64_t lo,
     return global::not_found;
 }
 
+// As scan_binary_search, but probing where id would be if the values in
+// [lo, hi] were evenly spread between those at lo and hi. This takes
+// O(log log n) probes on near-uniform values; after max_probes probes,
+// the search falls back to binary search in what is left.
+template <typename S>
+inline uint64_t interpolation_search(S const& sequence, uint64_t id,
+                                     uint64_t lo, uint64_t hi) {
+    static const uint64_t max_probes = 4;
+    uint64_t lo_val = sequence.access(lo);
+    uint64_t hi_val = sequence.access(hi);
+    for (uint64_t probes = 0; probes != max_probes; ++probes) {
+        if (id <= lo_val) return id == lo_val ? lo : global::not_found;
+        if (id >= hi_val) return id == hi_val ? hi : global::not_found;
+        if (hi - lo <= global::linear_scan_threshold) break;
+        // lo_val < id < hi_val, so that lo < pos < hi
+        uint64_t pos = lo + 1 +
+                       uint64_t(static_cast<unsigned __int128>(id - lo_val) *
+                                (hi - lo - 1) / (hi_val - lo_val));
+        uint64_t val = sequence.access(pos);
+        if (val == id) return pos;
+        if (val < id) {
+            lo = pos;
+            lo_val = val;
+        } else {
+            hi = pos;
+            hi_val = val;
+        }
+    }
+    return scan_binary_search(sequence, id, lo, hi);
+}
+
+namespace search {
+
+enum type { binary = 0, interpolation = 1 };
+
+// Return the position of id in [lo, hi], or global::not_found.
+template <typename S>
+inline uint64_t find(S const& sequence, uint64_t id, uint64_t lo, uint64_t hi,
+                     uint8_t type) {
+    if (type == interpolation) {
+        return interpolation_search(sequence, id, lo, hi);
+    }
+    return scan_binary_search(sequence, id, lo, hi);
+}
+
+// Counts the probes of a search: the random accesses, and a final scan
+// as one.
+template <typename S>
+struct probe_counter {
+    probe_counter(S const& sequence) : sequence(sequence), probes(0) {}
+
+    uint64_t access(uint64_t i) const {
+        ++probes;
+        return sequence.access(i);
+    }
+
+    auto at(uint64_t i) const {
+        ++probes;
+        return sequence.at(i);
+    }
+
+    S const& sequence;
+    mutable uint64_t probes;
+};
+
+// The search that makes fewer probes to find the values of a sample of the
+// ranges, given by pointers. Interpolation search wins on ranges of evenly
+// spread values, binary search on the others.
+template <typename S, typename Pointers>
+uint8_t choose(S const& sequence, Pointers const& pointers) {
+    static const uint64_t sample_ranges = 1024;
+    static const uint64_t samples_per_range = 4;
+    if (pointers.size() < 2) return binary;
+    uint64_t ranges = pointers.size() - 1;
+    uint64_t step = ranges / sample_ranges + 1;
+    probe_counter<S> binary_probes(sequence);
+    probe_counter<S> interpolation_probes(sequence);
+    uint64_t hash = 0;
+    auto it = pointers.begin();
+    uint64_t begin = *it;
+    for (uint64_t i = 0; i != ranges; ++i) {
+        ++it;
+        uint64_t end = *it;
+        uint64_t n = end - begin;
+        // shorter ranges are scanned by both searches
+        if (i % step == 0 and n > global::linear_scan_threshold + 1) {
+            for (uint64_t j = 0; j != samples_per_range; ++j) {
+                // pseudo-random, as fixed positions favour binary search
+                hash = hash * 6364136223846793005ULL + 1442695040888963407ULL;
+                uint64_t pos = begin + (hash >> 33) % n;
+                uint64_t id = sequence.access(pos);
+                scan_binary_search(binary_probes, id, begin, end - 1);
+                interpolation_search(interpolation_probes, id, begin, end - 1);
+            }
+        }
+        begin = end;
+    }
+    return interpolation_probes.probes < binary_probes.probes ? interpolation
+                                                              : binary;
+}
+
+// Finds ids in ranges of a sequence that are searched in increasing order,
+// as those of the children of a node. By default every range is searched
+// on its own: sequences that can carry a cursor from one range to the next
+// specialize this.
+template <typename S>
+struct range_finder {
+    range_finder() {}
+
+    range_finder(S const& sequence, uint64_t /* begin */)
+        : m_sequence(&sequence) {}
+
+    // the position of id in r, or global::not_found
+    uint64_t find(range const& r, uint64_t id) {
+        return m_sequence->find(r, id);
+    }
+
+    // an iterator at pos in r, usually the position last found
+    typename S::iterator at(range const& r, uint64_t pos) {
+        return m_sequence->at(r, pos);
+    }
+
+private:
+    S const* m_sequence;
+};
+
+}  // namespace search
+
+// Return the position of the first element >= id in [lo, hi), or hi.
+// The search gallops from lo, as the next key is usually close by when
+// intersecting sequences.
+template <typename S>
+inline uint64_t next_geq_search(S const& sequence, uint64_t id, uint64_t lo,
+                                uint64_t hi) {
+    if (lo == hi or sequence.access(lo) >= id) return lo;
+    uint64_t step = 1;
+    while (lo + step < hi and sequence.access(lo + step) < id) {
+        lo += step;
+        step <<= 1;
+    }
+    hi = std::min(lo + step, hi);
+    ++lo;
+    while (lo < hi) {
+        uint64_t pos = lo + ((hi - lo) >> 1);
+        if (sequence.access(pos) < id) {
+            lo = pos + 1;
+        } else {
+            hi = pos;
+        }
+    }
+    return lo;
+}
+
 namespace tables {
 const uint8_t select_in_byte[2048] = {
     8, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3,
@@ -212,6 +373,35 @@ void permute(triplet& t, int perm) {
     }
 }
 
+// bring a triple in the order of the permutation perm back to (s,p,o)
+void unpermute(triplet& t, int perm) {
+    triplet x = t;
+    switch (perm) {
+        case permutation_type::spo:
+            break;
+        case permutation_type::pos:
+            t.first = x.third;
+            t.second = x.first;
+            t.third = x.second;
+            break;
+        case permutation_type::osp:
+            t.first = x.second;
+            t.second = x.third;
+            t.third = x.first;
+            break;
+        case permutation_type::ops:
+            t.first = x.third;
+            t.third = x.first;
+            break;
+        case permutation_type::pso:
+            t.first = x.second;
+            t.second = x.first;
+            break;
+        default:
+            assert(false);
+    }
+}
+
 template <typename T>
 inline void prefetch(T const* ptr) {
     _mm_prefetch(reinterpret_cast<const char*>(ptr), _MM_HINT_T0);
@@ -36,9 +36,26 @@ struct triplet {
         return os;
     }
 
+    // the i-th component, for i < 3
+    uint64_t& operator[](uint32_t i) {
+        assert(i < 3);
+        return i == 0 ? first : (i == 1 ? second : third);
+    }
+
+    uint64_t operator[](uint32_t i) const {
+        assert(i < 3);
+        return i == 0 ? first : (i == 1 ? second : third);
+    }
+
     uint64_t first, second, third;
 };
 
+inline uint32_t num_wildcards(triplet const& t) {
+    return (t.first == global::wildcard_symbol) +
+           (t.second == global::wildcard_symbol) +
+           (t.third == global::wildcard_symbol);
+}
+
 enum permutation_type {
     spo = 1,
     pos = 2,
@@ -50,6 +67,40 @@ enum permutation_type {
 
 enum level_type { first = 1, second = 2, third = 3 };
 
+// assign the components (s,p,o) of a triple, as they appear in a
+// permutation file, to t according to the permutation perm
+inline void assign(triplet& t, uint64_t s, uint64_t p, uint64_t o, int perm) {
+    switch (perm) {
+        case permutation_type::spo:
+            t.first = s;
+            t.second = p;
+            t.third = o;
+            break;
+        case permutation_type::pos:
+            t.third = s;
+            t.first = p;
+            t.second = o;
+            break;
+        case permutation_type::osp:
+            t.second = s;
+            t.third = p;
+            t.first = o;
+            break;
+        case permutation_type::ops:
+            t.third = s;
+            t.second = p;
+            t.first = o;
+            break;
+        case permutation_type::pso:
+            t.second = s;
+            t.first = p;
+            t.third = o;
+            break;
+        default:
+            assert(false);
+    }
+}
+
 struct triplets_iterator {
     triplets_iterator(std::ifstream& in, int perm = permutation_type::spo)
         : m_perm(perm), m_in(in) {
@@ -61,7 +112,7 @@ struct triplets_iterator {
     }
 
     bool has_next() {
-        return !m_in.eof();
+        return !m_in.fail();
     }
 
     void operator++() {
@@ -78,35 +129,9 @@ private:
     std::ifstream& m_in;
 
     inline void read_next() {
-        switch (m_perm) {
-            case permutation_type::spo:
-                m_in >> m_val.first;
-                m_in >> m_val.second;
-                m_in >> m_val.third;
-                break;
-            case permutation_type::pos:
-                m_in >> m_val.third;
-                m_in >> m_val.first;
-                m_in >> m_val.second;
-                break;
-            case permutation_type::osp:
-                m_in >> m_val.second;
-                m_in >> m_val.third;
-                m_in >> m_val.first;
-                break;
-            case permutation_type::ops:
-                m_in >> m_val.third;
-                m_in >> m_val.second;
-                m_in >> m_val.first;
-                break;
-            case permutation_type::pso:
-                m_in >> m_val.second;
-                m_in >> m_val.first;
-                m_in >> m_val.third;
-                break;
-            default:
-                assert(false);
-        }
+        uint64_t s, p, o;
+        m_in >> s >> p >> o;
+        if (m_in) assign(m_val, s, p, o, m_perm);
     }
 };
 
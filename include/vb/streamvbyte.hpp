@@ -0,0 +1,177 @@
+#pragma once
+
+#include <immintrin.h>
+#include <vector>
+
+#include "util.hpp"
+#include "vb.hpp"
+
+namespace rdf {
+namespace vb {
+
+// Stream VByte: the byte lengths of the values are stored as 2-bit codes,
+// four per control byte, ahead of the bytes of the values, so that a group
+// of values is decoded with one shuffle of the data bytes.
+// Lengths are 1 to 4 bytes for 32-bit values and 1, 2, 4 or 8 bytes for
+// 64-bit values, of which a shuffle decodes 4 and 2 respectively.
+template <typename T>
+struct streamvbyte_traits;
+
+template <>
+struct streamvbyte_traits<uint32_t> {
+    static const uint64_t group_size = 4;  // values per shuffle
+
+    static uint8_t code(uint32_t x) {
+        return (x >= (1U << 8)) + (x >= (1U << 16)) + (x >= (1U << 24));
+    }
+
+    static uint64_t length(uint8_t code) {
+        return code + 1;
+    }
+};
+
+template <>
+struct streamvbyte_traits<uint64_t> {
+    static const uint64_t group_size = 2;
+
+    static uint8_t code(uint64_t x) {
+        return (x >= (uint64_t(1) << 8)) + (x >= (uint64_t(1) << 16)) +
+               (x >= (uint64_t(1) << 32));
+    }
+
+    static uint64_t length(uint8_t code) {
+        return uint64_t(1) << code;
+    }
+};
+
+template <typename T>
+struct streamvbyte {
+    typedef streamvbyte_traits<T> traits;
+    static const uint64_t group_size = traits::group_size;
+
+    static const uint64_t groups = uint64_t(1) << (2 * group_size);
+
+    // the shuffle and the length of each group, and the length of the
+    // values of each control byte
+    struct tables {
+        tables() {
+            for (uint64_t key = 0; key != groups; ++key) {
+                uint8_t byte = 0;
+                for (uint64_t i = 0; i != group_size; ++i) {
+                    uint64_t len = traits::length((key >> (2 * i)) & 3);
+                    for (uint64_t j = 0; j != sizeof(T); ++j) {
+                        shuffle[key][i * sizeof(T) + j] =
+                            j < len ? byte++ : 0x80;  // 0x80 zeroes
+                    }
+                }
+                group_length[key] = byte;
+            }
+            for (uint64_t c = 0; c != 256; ++c) {
+                control_length[c] = 0;
+                for (uint64_t i = 0; i != 4; ++i) {
+                    control_length[c] += traits::length((c >> (2 * i)) & 3);
+                }
+            }
+        }
+
+        alignas(16) uint8_t shuffle[groups][16];
+        uint8_t group_length[groups];
+        uint8_t control_length[256];
+    };
+
+    static tables const& get_tables() {
+        static const tables t;
+        return t;
+    }
+
+    static void encode(std::vector<uint8_t>& out, std::vector<T> const& in) {
+        uint64_t n = in.size();
+        uint64_t control_bytes = util::ceil_div(n, 4);
+        uint64_t begin = out.size();
+        out.resize(begin + control_bytes, 0);
+        for (uint64_t i = 0; i != n; ++i) {
+            T x = in[i];
+            uint8_t code = traits::code(x);
+            out[begin + i / 4] |= code << (2 * (i % 4));
+            for (uint64_t j = 0; j != traits::length(code); ++j) {
+                out.push_back(x >> (8 * j));
+            }
+        }
+    }
+
+    static uint8_t const* decode(uint8_t const* in, T* out, uint64_t n) {
+        tables const& t = get_tables();
+        uint64_t control_bytes = util::ceil_div(n, 4);
+        uint8_t const* control = in;
+        uint8_t const* data = in + control_bytes;
+
+        // groups are shuffled while their 16 bytes lie within the data
+        uint8_t const* end = data;
+        for (uint64_t i = 0; i != n / 4; ++i) {
+            end += t.control_length[control[i]];
+        }
+        for (uint64_t i = n / 4 * 4; i != n; ++i) {
+            end += traits::length((control[i / 4] >> (2 * (i % 4))) & 3);
+        }
+
+        uint64_t i = 0;
+#if defined(__SSSE3__)
+        for (; i + group_size <= n and data + 16 <= end; i += group_size) {
+            uint64_t key = (control[i / 4] >> (2 * (i % 4))) & (groups - 1);
+            __m128i bytes =
+                _mm_loadu_si128(reinterpret_cast<__m128i const*>(data));
+            __m128i shuffle = _mm_load_si128(
+                reinterpret_cast<__m128i const*>(t.shuffle[key]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                             _mm_shuffle_epi8(bytes, shuffle));
+            data += t.group_length[key];
+        }
+#endif
+        for (; i != n; ++i) {
+            uint64_t len =
+                traits::length((control[i / 4] >> (2 * (i % 4))) & 3);
+            T x = 0;
+            for (uint64_t j = 0; j != len; ++j) {
+                x |= T(data[j]) << (8 * j);
+            }
+            out[i] = x;
+            data += len;
+        }
+        assert(data == end);
+        return end;
+    }
+};
+
+struct streamvbyte_block {
+    typedef uint32_t value_type;
+    static const uint64_t block_size = global::block_size;
+
+    static void encode(std::vector<uint8_t>& out,
+                       std::vector<uint32_t>& in) {
+        streamvbyte<uint32_t>::encode(out, in);
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out,
+                                 uint64_t n) {
+        return streamvbyte<uint32_t>::decode(in, out, n);
+    }
+};
+
+// as streamvbyte_block, for values of up to 64 bits
+struct streamvbyte64_block {
+    typedef uint64_t value_type;
+    static const uint64_t block_size = global::block_size;
+
+    static void encode(std::vector<uint8_t>& out,
+                       std::vector<uint64_t>& in) {
+        streamvbyte<uint64_t>::encode(out, in);
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint64_t* out,
+                                 uint64_t n) {
+        return streamvbyte<uint64_t>::decode(in, out, n);
+    }
+};
+
+}  // namespace vb
+}  // namespace rdf
@@ -12,6 +12,7 @@ static const uint64_t block_size = 128;  // 256
 namespace vb {
 
 struct maskedvbyte_block {
+    typedef uint32_t value_type;
     static const uint64_t block_size = global::block_size;
 
     static void encode(std::vector<uint8_t>& out, std::vector<uint32_t>& in) {
@@ -27,6 +28,7 @@ struct maskedvbyte_block {
 };
 
 struct vbyte_block {
+    typedef uint32_t value_type;
     static const uint64_t block_size = global::block_size;
 
     static void encode(std::vector<uint8_t>& out, std::vector<uint32_t>& in) {
@@ -103,5 +105,37 @@ private:
     }
 };
 
+// as vbyte_block, for values of up to 64 bits
+struct vbyte64_block {
+    typedef uint64_t value_type;
+    static const uint64_t block_size = global::block_size;
+
+    static void encode(std::vector<uint8_t>& out, std::vector<uint64_t>& in) {
+        for (auto val : in) {
+            while (val >= (1U << 7)) {
+                out.push_back(val & ((1U << 7) - 1));
+                val >>= 7;
+            }
+            out.push_back(val | (1U << 7));
+        }
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint64_t* out, uint64_t n) {
+        const uint8_t* read = in;
+        for (size_t i = 0; i < n; ++i) {
+            unsigned int shift = 0;
+            for (uint64_t v = 0;; shift += 7) {
+                uint8_t c = *read++;
+                v += (uint64_t(c & 127) << shift);
+                if ((c & 128)) {
+                    *out++ = v;
+                    break;
+                }
+            }
+        }
+        return read;
+    }
+};
+
 }  // namespace vb
 }  // namespace rdf
\ No newline at end of file
@@ -2,7 +2,7 @@
 
 #include "../external/essentials/include/essentials.hpp"
 #include "util.hpp"
-#include "types.hpp"
+#include "registry.hpp"
 
 using namespace rdf;
 
@@ -25,7 +25,7 @@ void build(parameters const& params, char const* output_filename) {
     if (output_filename) {
         // essentials::print_size(index);
         util::logger("saving data structure to disk...");
-        essentials::save<Index>(index, output_filename);
+        save_index(index, output_filename);
         util::logger("DONE");
     }
 }
@@ -34,7 +34,8 @@ int main(int argc, char** argv) {
     int mandatory = 3;
     if (argc < mandatory) {
         std::cout << argv[0]
-                  << " <type> <collection_basename> [-o output_filename]"
+                  << " <type> <collection_basename> [-o output_filename] "
+                     "[-w space_weight]"
                   << std::endl;
         return 1;
     }
@@ -50,31 +51,23 @@ int main(int argc, char** argv) {
         if (std::string(argv[i]) == "-o") {
             ++i;
             output_filename = argv[i];
+        } else if (std::string(argv[i]) == "-w") {
+            ++i;
+            // used by the auto_3t index only
+            double space_weight = std::stod(argv[i]);
+            if (!(space_weight >= 0.0 and space_weight <= 1.0)) {
+                std::cerr << "Error: the space weight must be in [0, 1]"
+                          << std::endl;
+                return 1;
+            }
+            params.space_weight = space_weight;
         }
     }
 
-    // Yes...many ifs are ugly but this avoids the dependency from
-    // BOOST_PP_SEQ_FOR_EACH.
-
-    if (type == "compact_3t") {
-        build<compact_3t>(params, output_filename);
-    } else if (type == "ef_3t") {
-        build<ef_3t>(params, output_filename);
-    } else if (type == "pef_3t") {
-        build<pef_3t>(params, output_filename);
-    } else if (type == "vb_3t") {
-        build<vb_3t>(params, output_filename);
-    } else if (type == "pef_r_3t") {
-        build<pef_r_3t>(params, output_filename);
-    } else if (type == "pef_2to") {
-        build<pef_2to>(params, output_filename);
-    } else if (type == "pef_2tp") {
-        build<pef_2tp>(params, output_filename);
-    } else if (type == "vb_2tp") {
-        build<vb_2tp>(params, output_filename);
-    } else {
-        building_util::unknown_type(type);
-    }
+    bool known = dispatch(type, [&](auto tag) {
+        build<typename decltype(tag)::type>(params, output_filename);
+    });
+    if (!known) building_util::unknown_type(type);
 
     return 0;
 }
@@ -11,8 +11,7 @@ template <typename Permutation>
 void build(parameters const& params, int perm, char const* output_filename) {
     typename Permutation::builder builder(perm, params);
     Permutation permutation;
-    builder.build_first_and_second_level(permutation, params);
-    builder.build_third_level(permutation, params);
+    builder.build(permutation, params);
 
     double giga = essentials::convert(permutation.bytes(), essentials::GB);
     if (giga < 0.1) {
@@ -32,7 +31,7 @@ void build(parameters const& params, int perm, char const* output_filename) {
     if (output_filename) {
         // essentials::print_size(permutation);
         util::logger("saving data structure to disk...");
-        essentials::save<Permutation>(permutation, output_filename);
+        save<Permutation>(permutation, output_filename);
         util::logger("DONE");
     }
 }
@@ -0,0 +1,48 @@
+#include <iostream>
+
+#include "util.hpp"
+#include "triplets_reader.hpp"
+
+using namespace rdf;
+
+int main(int argc, char** argv) {
+    int mandatory = 3;
+    if (argc < mandatory) {
+        std::cout << argv[0] << " <collection_basename> <output_basename>"
+                  << std::endl;
+        std::cout << "Converts the permutation files of the collection "
+                     "from text to binary format."
+                  << std::endl;
+        return 1;
+    }
+
+    std::string input_basename(argv[1]);
+    std::string output_basename(argv[2]);
+
+    for (int perm = permutation_type::spo; perm <= permutation_type::pso;
+         ++perm) {
+        std::string input_filename = input_basename + "." + suffix(perm);
+        if (!std::ifstream(input_filename).good()) {
+            util::logger("'" + input_filename + "' not found: skipping it");
+            continue;
+        }
+        if (binary_triplets::is_binary(input_filename)) {
+            util::logger("'" + input_filename +
+                         "' is already binary: skipping it");
+            continue;
+        }
+        util::logger("converting '" + input_filename + "'...");
+        uint64_t n = binary_triplets::convert(
+            input_filename, output_basename + "." + suffix(perm));
+        util::logger("DONE: converted " + std::to_string(n) + " triplets");
+    }
+
+    // the statistics file is needed to build the indexes
+    std::ifstream stats(input_basename + ".stats");
+    if (stats.good()) {
+        std::ofstream out(output_basename + ".stats");
+        out << stats.rdbuf();
+    }
+
+    return 0;
+}
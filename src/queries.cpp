@@ -1,7 +1,9 @@
 #include <iostream>
+#include <numeric>
+#include <thread>
 
 #include "../external/essentials/include/essentials.hpp"
-#include "types.hpp"
+#include "registry.hpp"
 #include "util.hpp"
 #include "util_types.hpp"
 
@@ -16,12 +18,135 @@ uint32_t num_runs(uint32_t runs, uint32_t n) {
     return r;
 }
 
+// Run a query, returning the number of triples returned.
+template <typename Index>
+uint64_t run_query(Index const& index, triplet const& query,
+                   uint64_t num_wildcards) {
+    if (num_wildcards == 0) {
+        essentials::do_not_optimize_away(index.is_member(query));
+        return 1;
+    }
+    uint64_t num_triples = 0;
+    auto query_it = index.select(query);
+    while (query_it.has_next()) {
+        auto t = *query_it;
+        essentials::do_not_optimize_away(t.first);
+        ++num_triples;
+        ++query_it;
+    }
+    return num_triples;
+}
+
+// Run queries[begin, end), recording the latency of each query (in
+// nanoseconds) if latencies is not null: the clock is read only then.
+// Return the number of triples returned.
+template <typename Index>
+uint64_t run_queries(Index const& index, std::vector<triplet> const& queries,
+                     uint64_t num_wildcards, uint64_t begin, uint64_t end,
+                     double* latencies) {
+    typedef std::chrono::high_resolution_clock clock_type;
+    uint64_t num_triples = 0;
+    if (!latencies) {
+        for (uint64_t i = begin; i != end; ++i) {
+            num_triples += run_query(index, queries[i], num_wildcards);
+        }
+        return num_triples;
+    }
+    for (uint64_t i = begin; i != end; ++i) {
+        auto start = clock_type::now();
+        num_triples += run_query(index, queries[i], num_wildcards);
+        auto stop = clock_type::now();
+        latencies[i] =
+            std::chrono::duration<double, std::nano>(stop - start).count();
+    }
+    return num_triples;
+}
+
+struct throughput_stats {
+    double elapsed;  // in seconds
+    uint64_t num_triples;
+    std::vector<double> latencies;  // if timed
+};
+
+// Split the queries evenly among threads sharing the same index.
+template <typename Index>
+throughput_stats run_threads(Index const& index,
+                             std::vector<triplet> const& queries,
+                             uint64_t num_wildcards, uint32_t threads,
+                             bool timed) {
+    throughput_stats stats;
+    if (timed) stats.latencies.resize(queries.size());
+    std::vector<uint64_t> num_triples(threads, 0);
+    std::vector<std::thread> workers;
+    uint64_t chunk = util::ceil_div(queries.size(), threads);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i != threads; ++i) {
+        uint64_t begin = std::min<uint64_t>(i * chunk, queries.size());
+        uint64_t end = std::min<uint64_t>(begin + chunk, queries.size());
+        workers.emplace_back([&, i, begin, end]() {
+            num_triples[i] =
+                run_queries(index, queries, num_wildcards, begin, end,
+                            timed ? stats.latencies.data() : nullptr);
+        });
+    }
+    for (auto& w : workers) w.join();
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    stats.elapsed = std::chrono::duration<double>(stop - start).count();
+    stats.num_triples =
+        std::accumulate(num_triples.begin(), num_triples.end(), uint64_t(0));
+    return stats;
+}
+
+template <typename Index>
+void throughput(Index const& index, std::vector<triplet> const& queries,
+                uint64_t num_wildcards, uint32_t threads) {
+    if (queries.empty()) {
+        std::cout << "\tNo queries were run" << std::endl;
+        return;
+    }
+
+    // warm up the page cache and measure the single-threaded baseline;
+    // the throughput is measured without reading the clock per query, and
+    // the latencies in a separate pass
+    run_threads(index, queries, num_wildcards, 1, false);
+    auto baseline = run_threads(index, queries, num_wildcards, 1, false);
+    double baseline_qps = queries.size() / baseline.elapsed;
+    auto stats =
+        threads == 1
+            ? baseline
+            : run_threads(index, queries, num_wildcards, threads, false);
+
+    double qps = queries.size() / stats.elapsed;
+    auto latencies =
+        run_threads(index, queries, num_wildcards, threads, true).latencies;
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        uint64_t i = p * (latencies.size() - 1);
+        return latencies[i] / 1000;  // in microseconds
+    };
+
+    std::cout << "\tThreads: " << threads << "\n";
+    std::cout << "\tReturned triples: " << stats.num_triples << "\n";
+    std::cout << "\tQueries per second: " << qps << "\n";
+    std::cout << "\tTriples per second: " << stats.num_triples / stats.elapsed
+              << "\n";
+    std::cout << "\tScaling efficiency: " << qps / (threads * baseline_qps)
+              << "\n";
+    std::cout << "\tLatency p50: " << percentile(0.5) << " [musec]\n";
+    std::cout << "\tLatency p99: " << percentile(0.99) << " [musec]\n";
+    std::cout << "\tLatency p999: " << percentile(0.999) << " [musec]";
+    std::cout << std::endl;
+}
+
 template <typename Index>
 void queries(char const* binary_filename, char const* query_filename, int perm,
              uint32_t runs, uint64_t num_queries, uint64_t num_wildcards,
-             bool all) {
+             bool all, uint32_t threads) {
     Index index;
-    essentials::load(index, binary_filename);
+    mapped_file file(binary_filename);
+    map_index(index, file);
     // essentials::print_size(index);
 
     essentials::timer_type t;
@@ -32,15 +157,16 @@ void queries(char const* binary_filename, char const* query_filename, int perm,
         util::logger("returning all triplets");
         num_queries = 1;
 
+        // the triples are decoded in batches, see trie::iterator::next_batch
+        static const uint64_t batch_size = 1024;
+        std::vector<triplet> batch(batch_size);
         for (uint64_t run = 0; run != runs; ++run) {
             num_triples = 0;
             auto query_it = index.select_all();
             t.start();
-            while (query_it.has_next()) {
-                auto t = *query_it;
-                essentials::do_not_optimize_away(t.first);
-                ++num_triples;
-                ++query_it;
+            while (uint64_t n = query_it.next_batch(batch.data(), batch_size)) {
+                essentials::do_not_optimize_away(batch[n - 1].first);
+                num_triples += n;
             }
             t.stop();
         }
@@ -92,6 +218,13 @@ void queries(char const* binary_filename, char const* query_filename, int perm,
         }
         assert(num_queries == queries.size());
 
+        if (threads) {
+            util::logger("running queries on " + std::to_string(threads) +
+                         " threads");
+            throughput(index, queries, num_wildcards, threads);
+            return;
+        }
+
         util::logger("running queries");
 
         if (num_wildcards == 0) {
@@ -162,22 +295,22 @@ void queries(char const* binary_filename, char const* query_filename, int perm,
 }
 
 int main(int argc, char** argv) {
-    int mandatory = 4;
+    int mandatory = 3;
     if (argc < mandatory) {
         std::cout << argv[0]
-                  << " <type> <perm> <index_filename> [-q <query_filename> -n "
-                     "<num_queries> -w <num_wildcards>]"
+                  << " <perm> <index_filename> [-q <query_filename> -n "
+                     "<num_queries> -w <num_wildcards> --threads <threads>]"
                   << std::endl;
         return 1;
     }
 
     bool all = true;
-    std::string type(argv[1]);
-    int perm = std::stoi(argv[2]);
-    char const* index_filename = argv[3];
+    int perm = std::stoi(argv[1]);
+    char const* index_filename = argv[2];
     char const* query_filename = nullptr;
     uint64_t num_queries = 0;
     uint64_t num_wildcards = 0;
+    uint32_t threads = 0;
 
     for (int i = mandatory; i != argc; ++i) {
         if (std::string(argv[i]) == "-q") {
@@ -190,38 +323,21 @@ int main(int argc, char** argv) {
         } else if (!all and std::string(argv[i]) == "-w") {
             ++i;
             num_wildcards = std::stoull(argv[i]);
+        } else if (!all and std::string(argv[i]) == "--threads") {
+            ++i;
+            threads = std::stoul(argv[i]);
         }
     }
 
-    static const uint32_t runs = 5;
-
-    if (type == "compact_3t") {
-        queries<compact_3t>(index_filename, query_filename, perm, runs,
-                            num_queries, num_wildcards, all);
-    } else if (type == "ef_3t") {
-        queries<ef_3t>(index_filename, query_filename, perm, runs, num_queries,
-                       num_wildcards, all);
-    } else if (type == "pef_3t") {
-        queries<pef_3t>(index_filename, query_filename, perm, runs, num_queries,
-                        num_wildcards, all);
-    } else if (type == "vb_3t") {
-        queries<vb_3t>(index_filename, query_filename, perm, runs, num_queries,
-                       num_wildcards, all);
-    } else if (type == "pef_r_3t") {
-        queries<pef_r_3t>(index_filename, query_filename, perm, runs,
-                          num_queries, num_wildcards, all);
-    } else if (type == "pef_2to") {
-        queries<pef_2to>(index_filename, query_filename, perm, runs,
-                         num_queries, num_wildcards, all);
-    } else if (type == "pef_2tp") {
-        queries<pef_2tp>(index_filename, query_filename, perm, runs,
-                         num_queries, num_wildcards, all);
-    } else if (type == "vb_2tp") {
-        queries<vb_2tp>(index_filename, query_filename, perm, runs, num_queries,
-                        num_wildcards, all);
-    } else {
-        building_util::unknown_type(type);
-    }
+    constexpr uint32_t runs = 5;
+
+    std::string type = index_type(index_filename);
+    bool known = dispatch(type, [&](auto tag) {
+        queries<typename decltype(tag)::type>(index_filename, query_filename,
+                                              perm, runs, num_queries,
+                                              num_wildcards, all, threads);
+    });
+    if (!known) building_util::unknown_type(type);
 
     return 0;
 }
@@ -1,7 +1,7 @@
 #include <iostream>
 
 #include "stats.hpp"
-#include "types.hpp"
+#include "registry.hpp"
 #include "util.hpp"
 
 using namespace rdf;
@@ -9,41 +9,27 @@ using namespace rdf;
 template <typename Index>
 void statistics(char const* index_filename) {
     Index index;
-    essentials::load<Index>(index, index_filename);
+    mapped_file file(index_filename);
+    map_index(index, file);
     essentials::json_lines stats;
     index.print_stats(stats);
     stats.save_to_file((std::string(index_filename) + ".stats").c_str());
 }
 
 int main(int argc, char** argv) {
-    int mandatory = 3;
+    int mandatory = 2;
     if (argc < mandatory) {
-        std::cout << argv[0] << " <type> <index_filename>" << std::endl;
+        std::cout << argv[0] << " <index_filename>" << std::endl;
         return 1;
     }
 
-    std::string type(argv[1]);
-    char const* index_filename = argv[2];
+    char const* index_filename = argv[1];
+    std::string type = index_type(index_filename);
 
-    if (type == "compact_3t") {
-        statistics<compact_3t>(index_filename);
-    } else if (type == "ef_3t") {
-        statistics<ef_3t>(index_filename);
-    } else if (type == "pef_3t") {
-        statistics<pef_3t>(index_filename);
-    } else if (type == "vb_3t") {
-        statistics<vb_3t>(index_filename);
-    } else if (type == "pef_r_3t") {
-        statistics<pef_r_3t>(index_filename);
-    } else if (type == "pef_2to") {
-        statistics<pef_2to>(index_filename);
-    } else if (type == "pef_2tp") {
-        statistics<pef_2tp>(index_filename);
-    } else if (type == "vb_2tp") {
-        statistics<vb_2tp>(index_filename);
-    } else {
-        building_util::unknown_type(type);
-    }
+    bool known = dispatch(type, [&](auto tag) {
+        statistics<typename decltype(tag)::type>(index_filename);
+    });
+    if (!known) building_util::unknown_type(type);
 
     return 0;
 }
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+
+#include "util.hpp"
+#include "registry.hpp"
+
+using namespace rdf;
+
+typedef std::vector<uint64_t> bindings_type;
+
+uint64_t leapfrog_queries = 0;
+
+term c(uint64_t id) {
+    return term::constant(id);
+}
+
+term v(uint64_t var) {
+    return term::variable(var);
+}
+
+// the triples matching a pattern, hashed on each component
+struct matches_type {
+    std::vector<triplet> triplets;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> by_component[3];
+};
+
+// Reference evaluation: join the triples matching each pattern, in the
+// given order, looking up those agreeing on a component bound so far.
+void naive_join(std::vector<triple_pattern> const& patterns,
+                std::vector<matches_type> const& matches, uint64_t k,
+                bindings_type& bindings, std::vector<bindings_type>& out) {
+    if (k == patterns.size()) {
+        out.push_back(bindings);
+        return;
+    }
+    std::vector<uint32_t> all;
+    std::vector<uint32_t> const* candidates = nullptr;
+    for (uint32_t i = 0; i != 3 and !candidates; ++i) {
+        auto const& c = patterns[k][i];
+        if (!c.is_variable or bindings[c.value] == global::wildcard_symbol) {
+            continue;
+        }
+        auto const& hash = matches[k].by_component[i];
+        auto it = hash.find(bindings[c.value]);
+        if (it == hash.end()) return;
+        candidates = &(it->second);
+    }
+    if (!candidates) {
+        all.resize(matches[k].triplets.size());
+        std::iota(all.begin(), all.end(), 0);
+        candidates = &all;
+    }
+    bindings_type saved = bindings;
+    for (auto j : *candidates) {
+        auto const& t = matches[k].triplets[j];
+        bool consistent = true;
+        for (uint32_t i = 0; i != 3; ++i) {
+            if (!patterns[k][i].is_variable) continue;
+            uint64_t& value = bindings[patterns[k][i].value];
+            if (value == global::wildcard_symbol) {
+                value = t[i];
+            } else if (value != t[i]) {
+                consistent = false;
+            }
+        }
+        if (consistent) naive_join(patterns, matches, k + 1, bindings, out);
+        bindings = saved;
+    }
+}
+
+// true if a pattern holds a variable more than once
+bool repeats_variable(std::vector<triple_pattern> const& patterns) {
+    for (auto const& pattern : patterns) {
+        for (uint32_t i = 0; i != 3; ++i) {
+            for (uint32_t k = i + 1; k != 3; ++k) {
+                if (pattern[i].is_variable and pattern[k].is_variable and
+                    pattern[i].value == pattern[k].value) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+template <typename Index>
+bool check(Index const& index, std::vector<triple_pattern> const& patterns) {
+    std::vector<matches_type> matches;
+    for (auto const& pattern : patterns) {
+        triplet t;
+        for (uint32_t i = 0; i != 3; ++i) {
+            if (!pattern[i].is_variable) t[i] = pattern[i].value;
+        }
+        matches.emplace_back();
+        auto& m = matches.back();
+        if (index.count(t) == 0) continue;
+        if (num_wildcards(t) == 0) {
+            m.triplets.push_back(t);
+        } else {
+            auto it =
+                num_wildcards(t) == 3 ? index.select_all() : index.select(t);
+            int perm = num_wildcards(t) == 3 ? permutation_type::spo
+                                             : Index::select_permutation(t);
+            while (it.has_next()) {
+                triplet x = *it;
+                util::unpermute(x, perm);
+                m.triplets.push_back(x);
+                ++it;
+            }
+        }
+        for (uint32_t j = 0; j != m.triplets.size(); ++j) {
+            for (uint32_t i = 0; i != 3; ++i) {
+                m.by_component[i][m.triplets[j][i]].push_back(j);
+            }
+        }
+    }
+
+    bgp<Index> query(index, patterns);
+    std::vector<bindings_type> expected;
+    bindings_type bindings(query.variables(), global::wildcard_symbol);
+    naive_join(patterns, matches, 0, bindings, expected);
+
+    std::vector<bindings_type> got;
+    for (auto it = query.select(); it.has_next(); ++it) got.push_back(*it);
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(got.begin(), got.end());
+    if (got != expected) {
+        std::cout << "Error: got " << got.size() << " solutions, expected "
+                  << expected.size() << std::endl;
+        return false;
+    }
+
+    // not every query has an order of the variables compatible with the
+    // permutations of the index, and leapfrog_join rejects the patterns
+    // repeating a variable
+    try {
+        leapfrog_join<Index> join(index, patterns);
+        got.clear();
+        for (auto it = join.select(); it.has_next(); ++it) got.push_back(*it);
+    } catch (std::invalid_argument const& e) {
+        bool repeated = std::string(e.what()).find("is repeated") !=
+                        std::string::npos;
+        if (repeated != repeats_variable(patterns)) {
+            std::cout << "Error: leapfrog join rejected the query with \""
+                      << e.what() << "\"" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    if (repeats_variable(patterns)) {
+        std::cout << "Error: leapfrog join accepted a repeated variable"
+                  << std::endl;
+        return false;
+    }
+    std::sort(got.begin(), got.end());
+    if (got != expected) {
+        std::cout << "Error: leapfrog join got " << got.size()
+                  << " solutions, expected " << expected.size() << std::endl;
+        return false;
+    }
+    ++leapfrog_queries;
+    return true;
+}
+
+template <typename Index>
+void check(char const* index_filename) {
+    Index index;
+    load_index(index, index_filename);
+
+    static const uint64_t samples = 16;
+    uint64_t step = index.triplets() / samples + 1;
+    std::vector<triplet> triplets;
+    auto all = index.select_all();
+    for (uint64_t i = 0; all.has_next(); ++i, ++all) {
+        if (i % step == 0) triplets.push_back(*all);
+    }
+
+    uint64_t checked = 0;
+    for (auto const& t : triplets) {
+        uint64_t s = t.first, p = t.second, o = t.third;
+        std::vector<std::vector<triple_pattern>> queries = {
+            // paths
+            {{c(s), v(0), v(1)}, {v(1), v(2), v(3)}},
+            {{v(0), c(p), c(o)}, {v(0), v(1), v(2)}},
+            {{v(0), c(p), v(1)}, {v(1), c(p), c(s)}},
+            // two shared variables and a filter
+            {{c(s), v(0), v(1)}, {v(2), v(0), v(1)}},
+            {{c(s), v(0), v(1)}, {c(s), v(0), v(1)}},
+            // cycles
+            {{c(s), v(0), v(1)}, {v(1), v(2), v(3)}, {v(3), c(p), c(s)}},
+            {{v(0), c(p), v(1)}, {v(1), c(p), v(2)}, {v(0), c(p), v(2)}},
+            // a repeated variable and constant patterns
+            {{v(0), v(1), v(0)}},
+            {{v(0), c(p), v(0)}, {v(0), c(p), v(1)}},
+            {{c(s), c(p), c(o)}, {c(s), v(0), v(1)}},
+            {{c(s), c(p), c(o + 1)}, {c(s), v(0), v(1)}},
+            // constant patterns only: one empty solution if all match
+            {{c(s), c(p), c(o)}},
+            {{c(s), c(p), c(o)}, {c(s), c(p), c(o + 1)}},
+        };
+        for (auto const& patterns : queries) {
+            if (!check(index, patterns)) return;
+            ++checked;
+        }
+    }
+    util::logger("checked " + std::to_string(checked) + " queries, " +
+                 std::to_string(leapfrog_queries) + " also with leapfrog");
+    util::logger("OK");
+}
+
+int main(int argc, char** argv) {
+    int mandatory = 2;
+    if (argc < mandatory) {
+        std::cout << argv[0] << " <index_filename>" << std::endl;
+        return 1;
+    }
+
+    char const* index_filename = argv[1];
+
+    std::string type = index_type(index_filename);
+    bool known = dispatch(type, [&](auto tag) {
+        check<typename decltype(tag)::type>(index_filename);
+    });
+    if (!known) building_util::unknown_type(type);
+
+    return 0;
+}
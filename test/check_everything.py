@@ -8,10 +8,14 @@ index_types = [
                   "compact_3t"
                 , "ef_3t"
                 , "vb_3t"
+                , "svb_3t"
+                , "auto_3t"
                 , "pef_3t"
+                , "pef_opt_3t"
                 , "pef_r_3t"
                 , "pef_2to"
-                ,"pef_2tp"
+                , "pef_2tp"
+                , "vb_2tp"
               ]
 
 executables = [
@@ -23,9 +27,12 @@ executables = [
 for type in index_types:
     output_filename = path_to_binaries + "/" + prefix_name + "." + type + ".bin"
     for program in executables:
-        cmd = "./" + program + " " + type + " " + path_to_basename
         if program == "build":
-            cmd += " -o"
+            cmd = "./build " + type + " " + path_to_basename + " -o"
+        else:
+            cmd = "./" + program + " " + path_to_basename
         cmd += " " + output_filename
         os.system(cmd)
+    os.system("./check_find " + output_filename)
+    os.system("./check_bgp " + output_filename)
     os.system("rm " + output_filename)
\ No newline at end of file
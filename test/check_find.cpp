@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <iostream>
+#include <random>
+#include <set>
 
 #include "util.hpp"
-#include "types.hpp"
+#include "registry.hpp"
 
 using namespace rdf;
 
@@ -24,7 +27,30 @@ void check_find(Trie& permutation) {
         uint64_t j = r.begin;
         uint64_t in_range = begin;
 
+        // a level iterator skipping forward to every k in turn
+        typename Trie::levels_type::third::iterator skipping(
+            nodes.at(r, r.begin), permutation.second.pointers.at(i));
+
         for (uint64_t k = begin; k != end; ++k) {
+            // j is the position of the first id >= k
+            uint64_t mid = r.begin + (r.end - r.begin) / 2;
+            uint64_t got = nodes.next_geq(r, r.begin, k);
+            uint64_t got_mid = nodes.next_geq(r, mid, k);
+            if (got != j or got_mid != std::max(j, mid)) {
+                std::cout << "Error: next_geq(" << k << ") in range ("
+                          << r.begin << " - " << r.end << ") returned " << got
+                          << " and " << got_mid << " from " << mid
+                          << ", expected " << j << std::endl;
+            }
+
+            if (!skipping.skip_to(k) or skipping.position() != j or
+                *skipping != nodes.access(r, j)) {
+                std::cout << "Error: skip_to(" << k << ") in range ("
+                          << r.begin << " - " << r.end << ") stopped at "
+                          << skipping.position() << ", expected " << j
+                          << std::endl;
+            }
+
             bool present = in_range == k;
             if (present) {
                 ++j;
@@ -33,10 +59,11 @@ void check_find(Trie& permutation) {
 
             uint64_t pos = nodes.find(r, k);
             if (present) {
-                if (pos == global::not_found) {
+                if (pos != j - 1) {
                     std::cout << "Error: " << k
                               << " should have been found in range (" << r.begin
-                              << " - " << r.end << ")" << std::endl;
+                              << " - " << r.end << ") at " << j - 1
+                              << std::endl;
                 }
             } else {
                 if (pos != global::not_found) {
@@ -47,6 +74,17 @@ void check_find(Trie& permutation) {
             }
         }
 
+        if (nodes.next_geq(r, r.begin, end + 1) != r.end) {
+            std::cout << "Error: next_geq(" << end + 1 << ") in range ("
+                      << r.begin << " - " << r.end << ") should be "
+                      << r.end << std::endl;
+        }
+        if (skipping.skip_to(end + 1) or skipping.position() != r.end - 1) {
+            std::cout << "Error: skip_to(" << end + 1 << ") in range ("
+                      << r.begin << " - " << r.end
+                      << ") should stop on the last node" << std::endl;
+        }
+
         uint64_t k = 0;
         bool present = k == nodes.access(r, r.begin);
         uint64_t pos = nodes.find(r, k);
@@ -70,64 +108,338 @@ void check_find(Trie& permutation) {
     }
 }
 
-template <typename Index>
-void check(char const* index_filename) {
-    Index index;
-    essentials::load(index, index_filename);
+// Check that a range_finder, moved across the ranges of the children of a
+// node, finds what find does: the first id of the first child and the last
+// id of the last child are searched under every child.
+template <typename Trie>
+void check_range_finder(Trie& permutation) {
+    typedef typename Trie::levels_type::third::nodes_type nodes_type;
+    auto const& nodes = permutation.third.nodes;
+    auto const& pointers = permutation.second.pointers;
+    uint64_t n = permutation.first.size();
+    uint64_t step = n / 1000 + 1;
+    util::logger("checking the range finder");
+
+    for (uint64_t i = 0; i < n; i += step) {
+        range r = permutation.first.pointers[i];
+        range first = pointers[r.begin];
+        range last = pointers[r.end - 1];
+        for (uint64_t id : {nodes.access(first, first.begin),
+                            nodes.access(last, last.end - 1)}) {
+            search::range_finder<nodes_type> finder(nodes, first.begin);
+            for (uint64_t j = r.begin; j != r.end; ++j) {
+                range rj = pointers[j];
+                uint64_t expected = nodes.find(rj, id);
+                uint64_t got = finder.find(rj, id);
+                if (got != expected) {
+                    std::cout << "Error: range_finder searched " << id
+                              << " in range (" << rj.begin << " - " << rj.end
+                              << ") at " << got << ", expected " << expected
+                              << std::endl;
+                    return;
+                }
+            }
+        }
+    }
+    util::logger("OK");
+}
+
+// a sorted vector, searched as a sequence
+struct vector_sequence {
+    uint64_t access(uint64_t i) const {
+        return values[i];
+    }
+
+    uint64_t const* at(uint64_t i) const {
+        return values.data() + i;
+    }
+
+    std::vector<uint64_t> values;
+};
+
+// Check both searches, on both a vector_sequence and the kernels of a
+// compact_vector, against std::lower_bound: for every value, its
+// neighbours and every id up to 4n, on sequences of n values that are
+// evenly spread, skewed or clustered.
+void check_search() {
+    util::logger("checking the searches");
+    std::mt19937_64 rng(13);
+    for (uint64_t n : {1, 2, 3, 9, 10, 17, 100, 1000}) {
+        for (int distribution = 0; distribution != 3; ++distribution) {
+            std::set<uint64_t> distinct;
+            while (distinct.size() != n) {
+                uint64_t x = rng() % (4 * n);
+                if (distribution == 1) x = x * x;
+                if (distribution == 2) x = x % 8 + x / 8 * 1000;
+                distinct.insert(x);
+            }
+            vector_sequence v{{distinct.begin(), distinct.end()}};
+            compact_vector cv;
+            compact_vector::builder cvb(v.values.begin(), n,
+                                        util::ceil_log2(v.values.back() + 2));
+            cvb.build(cv);
+            auto kernels = fixed_width::kernels_for(cv.width());
+
+            std::set<uint64_t> ids;
+            for (uint64_t id = 0; id <= 4 * n; ++id) ids.insert(id);
+            for (uint64_t x : v.values) ids.insert({x, x + 1, x ? x - 1 : 0});
+            for (uint64_t id : ids) {
+                auto it =
+                    std::lower_bound(v.values.begin(), v.values.end(), id);
+                uint64_t expected = it != v.values.end() and *it == id
+                                        ? it - v.values.begin()
+                                        : global::not_found;
+                for (int type : {search::binary, search::interpolation}) {
+                    uint64_t got = search::find(v, id, 0, n - 1, type);
+                    uint64_t got_cv =
+                        kernels->find(cv.bits().data(), id, 0, n - 1, type);
+                    if (got != expected or got_cv != expected) {
+                        std::cout << "Error: search " << type << " of " << id
+                                  << " among " << n << " values of "
+                                  << "distribution " << distribution
+                                  << " returned " << got << " and " << got_cv
+                                  << ", expected " << expected << std::endl;
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    util::logger("OK");
+}
+
+// Check a block_sequence on ranges of values up to max, both below 2^32
+// and above it (that are encoded with the wide blocks): access, find,
+// next_geq, iteration and next_values against the input values.
+template <typename Sequence>
+bool check_block_sequence(std::string const& name, uint64_t max) {
+    std::mt19937_64 rng(13);
+    std::vector<uint64_t> values, endpoints = {0};
+    std::vector<uint32_t> begins;
+    for (uint64_t i = 0; i != 100; ++i) {
+        uint64_t n = rng() % 300 + 1;
+        std::set<uint64_t> distinct;
+        if (i % 10 == 0) distinct.insert(max);
+        while (distinct.size() != n) distinct.insert(rng() % max);
+        for (uint64_t x : distinct) {
+            begins.push_back(x == *distinct.begin());
+            values.push_back(x);
+        }
+        endpoints.push_back(values.size());
+    }
+
+    compact_vector::builder from(values.begin(), values.size(),
+                                 util::ceil_log2(max + 1));
+    compact_vector::builder pointers(endpoints.begin(), endpoints.size(),
+                                     util::ceil_log2(values.size() + 1));
+    Sequence s;
+    s.build(from, pointers);
+
+    auto error = [&](std::string const& what, range r, uint64_t pos,
+                     uint64_t got, uint64_t expected) {
+        std::cout << "Error: " << name << " with values up to " << max
+                  << ": " << what << " in range (" << r.begin << " - "
+                  << r.end << ") at " << pos << " returned " << got
+                  << ", expected " << expected << std::endl;
+        return false;
+    };
+
+    for (uint64_t i = 0; i + 1 != endpoints.size(); ++i) {
+        range r = {endpoints[i], endpoints[i + 1]};
+        auto it = s.at(r, r.begin);
+        for (uint64_t pos = r.begin; pos != r.end; ++pos, ++it) {
+            uint64_t x = values[pos];
+            if (*it != x) return error("iteration", r, pos, *it, x);
+            if (s.access(r, pos) != x) {
+                return error("access", r, pos, s.access(r, pos), x);
+            }
+            if (s.find(r, x) != pos) {
+                return error("find", r, pos, s.find(r, x), pos);
+            }
+            if (s.next_geq(r, r.begin, x) != pos) {
+                return error("next_geq", r, pos, s.next_geq(r, r.begin, x),
+                             pos);
+            }
+            if (x != max and s.next_geq(r, r.begin, x + 1) != pos + 1) {
+                return error("next_geq", r, pos,
+                             s.next_geq(r, r.begin, x + 1), pos + 1);
+            }
+            if ((pos + 1 == r.end or values[pos + 1] != x + 1) and
+                x != max and s.find(r, x + 1) != global::not_found) {
+                return error("find", r, pos, s.find(r, x + 1),
+                             global::not_found);
+            }
+        }
+    }
+
+    std::vector<uint64_t> got(values.size());
+    auto it = s.begin();
+    got[0] = *it;
+    it.next_values(got.data() + 1, values.size() - 1, begins.data() + 1);
+    for (uint64_t pos = 0; pos != values.size(); ++pos) {
+        if (got[pos] != values[pos]) {
+            return error("next_values", {0, s.size()}, pos, got[pos],
+                         values[pos]);
+        }
+    }
+    return true;
+}
+
+// Check a range_finder of a sequence, moved across groups of consecutive
+// ranges of random values, against find: the values of the first range of
+// each group, and the ids following them, are searched in every range of
+// the group.
+template <typename Sequence>
+bool check_range_finder(std::string const& name) {
+    static const uint64_t group = 8;
+    std::mt19937_64 rng(13);
+    std::vector<uint64_t> values, endpoints = {0};
+    for (uint64_t i = 0; i != 1000; ++i) {
+        uint64_t n = rng() % (i % 2 ? 300 : 10) + 1;
+        std::set<uint64_t> distinct;
+        while (distinct.size() != n) distinct.insert(rng() % 1000);
+        values.insert(values.end(), distinct.begin(), distinct.end());
+        endpoints.push_back(values.size());
+    }
+
+    compact_vector::builder from(values.begin(), values.size(),
+                                 util::ceil_log2(1000));
+    compact_vector::builder pointers(endpoints.begin(), endpoints.size(),
+                                     util::ceil_log2(values.size() + 1));
+    Sequence s;
+    s.build(from, pointers);
+
+    for (uint64_t i = 0; i + group < endpoints.size(); i += group) {
+        for (uint64_t pos = endpoints[i]; pos != endpoints[i + 1]; ++pos) {
+            for (uint64_t id : {values[pos], values[pos] + 1}) {
+                search::range_finder<Sequence> finder(s, endpoints[i]);
+                for (uint64_t j = i; j != i + group; ++j) {
+                    range r = {endpoints[j], endpoints[j + 1]};
+                    uint64_t expected = s.find(r, id);
+                    uint64_t got = finder.find(r, id);
+                    if (got != expected) {
+                        std::cout << "Error: range_finder of " << name
+                                  << " searched " << id << " in range ("
+                                  << r.begin << " - " << r.end << ") at "
+                                  << got << ", expected " << expected
+                                  << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void check_range_finders() {
+    util::logger("checking the range finders of the sequences");
+    if (!check_range_finder<pef::pef_sequence>("pef_sequence") or
+        !check_range_finder<pef::pef_opt_sequence>("pef_opt_sequence") or
+        !check_range_finder<compact_vector>("compact_vector")) {
+        return;
+    }
+    util::logger("OK");
+}
+
+// Check that the codec chosen by auto_sequence moves from the fastest to
+// the smallest as the space weight grows, on costs like those timed on
+// the levels of a 3T index, and that it changes in between.
+void check_auto_choices() {
+    util::logger("checking the choices of auto_sequence");
+    auto_sequence::cost costs[auto_sequence::num_codecs] = {
+        {20.0, {1.1, 8.0, 1.5}},       // compact
+        {5.0, {35.0, 70.0, 6.0}},      // elias_fano
+        {4.5, {250.0, 250.0, 10.0}},   // partitioned_elias_fano
+        {8.0, {500.0, 500.0, 15.0}}};  // variable_byte
+    std::set<uint8_t> chosen;
+    double prev_space = costs[auto_sequence::compact].space;
+    for (int i = 0; i <= 20; ++i) {
+        double w = i / 20.0;
+        uint8_t c = auto_sequence::choose(costs, w);
+        if ((i == 0 and c != auto_sequence::compact) or
+            (i == 20 and c != auto_sequence::partitioned_elias_fano) or
+            costs[c].space > prev_space) {
+            std::cout << "Error: auto_sequence chose "
+                      << auto_sequence::codec_name(c) << " with space weight "
+                      << w << std::endl;
+            return;
+        }
+        prev_space = costs[c].space;
+        chosen.insert(c);
+    }
+    if (chosen.size() != 3) {
+        std::cout << "Error: auto_sequence chose " << chosen.size()
+                  << " codecs across the space weights, expected 3"
+                  << std::endl;
+        return;
+    }
+    util::logger("OK");
+}
+
+void check_block_sequences() {
+    util::logger("checking the block sequences");
+    for (uint64_t max : {(uint64_t(1) << 32) - 1, uint64_t(1) << 32,
+                         uint64_t(1) << 40, uint64_t(1) << 63}) {
+        if (!check_block_sequence<vb_sequence>("vb_sequence", max) or
+            !check_block_sequence<svb_sequence>("svb_sequence", max)) {
+            return;
+        }
+    }
+    util::logger("OK");
+}
+
+template <typename SPO, typename POS, typename OSP>
+void check(index_3t<SPO, POS, OSP>& index) {
     check_find(index.spo());
     check_find(index.pos());
     check_find(index.osp());
+    check_range_finder(index.spo());
+    check_range_finder(index.pos());
+    check_range_finder(index.osp());
 }
 
-// specialization
-void check_2to(char const* index_filename) {
-    pef_2to index;
-    essentials::load(index, index_filename);
+template <typename SPO, typename OPS>
+void check(index_2to<SPO, OPS>& index) {
     check_find(index.spo());
     check_find(index.ops());
+    check_range_finder(index.spo());
+    check_range_finder(index.ops());
 }
 
-// specialization
-void check_2tp(char const* index_filename) {
-    pef_2tp index;
-    essentials::load(index, index_filename);
+template <typename SPO, typename POS>
+void check(index_2tp<SPO, POS>& index) {
     check_find(index.spo());
     check_find(index.pos());
+    check_range_finder(index.spo());
+    check_range_finder(index.pos());
+}
+
+template <typename Index>
+void check(char const* index_filename) {
+    Index index;
+    load_index(index, index_filename);
+    check(index);
 }
 
 int main(int argc, char** argv) {
-    int mandatory = 3;
+    int mandatory = 2;
     if (argc < mandatory) {
-        std::cout << argv[0] << " <type> <index_filename>" << std::endl;
+        std::cout << argv[0] << " <index_filename>" << std::endl;
         return 1;
     }
 
-    std::string type(argv[1]);
-    char const* index_filename = argv[2];
+    char const* index_filename = argv[1];
+    check_search();
+    check_block_sequences();
+    check_range_finders();
+    check_auto_choices();
 
-    if (type == "pef_2to") {
-        check_2to(index_filename);
-        return 0;
-    }
-
-    if (type == "pef_2tp") {
-        check_2tp(index_filename);
-        return 0;
-    }
-
-    if (type == "compact_3t") {
-        check<compact_3t>(index_filename);
-    } else if (type == "ef_3t") {
-        check<ef_3t>(index_filename);
-    } else if (type == "pef_3t") {
-        check<pef_3t>(index_filename);
-    } else if (type == "vb_3t") {
-        check<vb_3t>(index_filename);
-    } else if (type == "pef_r_3t") {
-        check<pef_r_3t>(index_filename);
-    } else {
-        building_util::unknown_type(type);
-    }
+    std::string type = index_type(index_filename);
+    bool known = dispatch(type, [&](auto tag) {
+        check<typename decltype(tag)::type>(index_filename);
+    });
+    if (!known) building_util::unknown_type(type);
 
     return 0;
 }
@@ -1,7 +1,7 @@
 #include <iostream>
 
 #include "util.hpp"
-#include "types.hpp"
+#include "registry.hpp"
 
 using namespace rdf;
 
@@ -9,8 +9,7 @@ template <typename Trie>
 void check_permutation(Trie& permutation, int perm, parameters const& params) {
     std::string filename =
         std::string(params.collection_basename) + "." + suffix(perm);
-    std::ifstream input(filename.c_str(), std::ios_base::in);
-    triplets_iterator input_it(input, perm);
+    triplets_reader input_it(filename, perm);
 
     util::logger("checking permutation " + suffix(perm));
     uint64_t quantum = 10000000;
@@ -33,77 +32,56 @@ void check_permutation(Trie& permutation, int perm, parameters const& params) {
         ++input_it;
     }
 
-    input.close();
     util::logger("checked " + std::to_string(n) + "/" +
                  std::to_string(params.num_triplets) + " triplets");
     util::logger("OK");
 }
 
-template <typename Index>
-void check(parameters const& params, char const* index_filename) {
-    Index index;
-    essentials::load(index, index_filename);
-    assert(index.triplets() == params.num_triplets);
+template <typename SPO, typename POS, typename OSP>
+void check(index_3t<SPO, POS, OSP>& index, parameters const& params) {
     check_permutation(index.spo(), permutation_type::spo, params);
     check_permutation(index.pos(), permutation_type::pos, params);
     check_permutation(index.osp(), permutation_type::osp, params);
 }
 
-// specialization
-void check_2to(parameters const& params, char const* index_filename) {
-    pef_2to index;
-    essentials::load(index, index_filename);
-    assert(index.triplets() == params.num_triplets);
+template <typename SPO, typename OPS>
+void check(index_2to<SPO, OPS>& index, parameters const& params) {
     check_permutation(index.spo(), permutation_type::spo, params);
     check_permutation(index.ops(), permutation_type::ops, params);
 }
 
-// specialization
-void check_2tp(parameters const& params, char const* index_filename) {
-    pef_2tp index;
-    essentials::load(index, index_filename);
-    assert(index.triplets() == params.num_triplets);
+template <typename SPO, typename POS>
+void check(index_2tp<SPO, POS>& index, parameters const& params) {
     check_permutation(index.spo(), permutation_type::spo, params);
     check_permutation(index.pos(), permutation_type::pos, params);
 }
 
+template <typename Index>
+void check(parameters const& params, char const* index_filename) {
+    Index index;
+    load_index(index, index_filename);
+    assert(index.triplets() == params.num_triplets);
+    check(index, params);
+}
+
 int main(int argc, char** argv) {
-    int mandatory = 4;
+    int mandatory = 3;
     if (argc < mandatory) {
-        std::cout << argv[0] << " <type> <collection_basename> <index_filename>"
+        std::cout << argv[0] << " <collection_basename> <index_filename>"
                   << std::endl;
         return 1;
     }
 
-    std::string type(argv[1]);
     parameters params;
-    params.collection_basename = argv[2];
+    params.collection_basename = argv[1];
     params.load();
-    char const* index_filename = argv[3];
-
-    if (type == "pef_2to") {
-        check_2to(params, index_filename);
-        return 0;
-    }
-
-    if (type == "pef_2tp") {
-        check_2tp(params, index_filename);
-        return 0;
-    }
+    char const* index_filename = argv[2];
 
-    if (type == "compact_3t") {
-        check<compact_3t>(params, index_filename);
-    } else if (type == "ef_3t") {
-        check<ef_3t>(params, index_filename);
-    } else if (type == "pef_3t") {
-        check<pef_3t>(params, index_filename);
-    } else if (type == "vb_3t") {
-        check<vb_3t>(params, index_filename);
-    } else if (type == "pef_r_3t") {
-        check<pef_r_3t>(params, index_filename);
-    } else {
-        building_util::unknown_type(type);
-    }
+    std::string type = index_type(index_filename);
+    bool known = dispatch(type, [&](auto tag) {
+        check<typename decltype(tag)::type>(params, index_filename);
+    });
+    if (!known) building_util::unknown_type(type);
 
     return 0;
 }
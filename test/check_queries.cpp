@@ -1,7 +1,8 @@
+#include <algorithm>
 #include <iostream>
 
 #include "util.hpp"
-#include "types.hpp"
+#include "registry.hpp"
 #include "util_types.hpp"
 
 using namespace rdf;
@@ -51,8 +52,7 @@ triplet prepare_query(triplet const& t, int perm, uint32_t num_wildcards) {
 template <typename Permutation>
 void check(parameters const& params, Permutation& permutation,
            const char* filename, int perm, int num_wildcards) {
-    std::ifstream input(filename, std::ios_base::in);
-    triplets_iterator input_it(input, perm);
+    triplets_reader input_it(filename, perm);
 
     util::logger("checking queries over permutation " + suffix(perm));
 
@@ -61,6 +61,8 @@ void check(parameters const& params, Permutation& permutation,
     if (params.num_triplets < quantum) quantum /= 10;
 
     if (num_wildcards == 0) {
+        std::vector<triplet> queries;
+        std::vector<uint64_t> ids;
         while (true) {
             triplet expected = *input_it;
             triplet query = prepare_query(expected, perm, num_wildcards);
@@ -68,6 +70,8 @@ void check(parameters const& params, Permutation& permutation,
             if (triplet_id == global::not_found) {
                 std::cerr << expected << " not found." << std::endl;
             }
+            queries.push_back(query);
+            ids.push_back(triplet_id);
             ++n;
             if (n % quantum == 0) {
                 std::cout << "checked " << n << "/" << params.num_triplets
@@ -76,16 +80,39 @@ void check(parameters const& params, Permutation& permutation,
             if (n == params.num_triplets) break;
             ++input_it;
         }
+
+        // batched lookups, in reverse order to exercise the sorting, with
+        // a query whose first component is beyond the first level
+        std::reverse(queries.begin(), queries.end());
+        std::reverse(ids.begin(), ids.end());
+        triplet beyond = queries[queries.size() / 2];
+        beyond.first = uint64_t(1) << 40;
+        queries.insert(queries.begin() + queries.size() / 2, beyond);
+        ids.insert(ids.begin() + ids.size() / 2, global::not_found);
+        std::vector<uint64_t> got(queries.size());
+        permutation.is_member(queries.data(), queries.size(), got.data());
+        for (uint64_t i = 0; i != queries.size(); ++i) {
+            if (!util::check(i, queries.size(), got[i], ids[i])) return;
+        }
     } else {
+        // batch sizes for next_batch, exercising both the boundaries of
+        // the batches and those of the buffers of the iterators
+        static const uint64_t batch_sizes[] = {1, 7, 300};
+        std::vector<triplet> batch(300);
+        std::vector<triplet> triplets;
+        uint64_t batches = 0;
         while (true) {
             triplet expected = *input_it;
             triplet query = prepare_query(expected, perm, num_wildcards);
             auto query_it = num_wildcards == 3 ? permutation.select_all()
                                                : permutation.select(query);
+            uint64_t begin = n;
+            triplets.clear();
             while (query_it.has_next()) {
                 triplet got = *query_it;
                 triplet expected = *input_it;
                 if (!util::check(n, params.num_triplets, got, expected)) return;
+                triplets.push_back(got);
                 ++n;
                 if (n % quantum == 0) {
                     std::cout << "checked " << n << "/" << params.num_triplets
@@ -94,6 +121,34 @@ void check(parameters const& params, Permutation& permutation,
                 ++query_it;
                 ++input_it;
             }
+            if (num_wildcards != 3 and
+                !util::check(begin, params.num_triplets,
+                             permutation.count(query), n - begin)) {
+                return;
+            }
+
+            auto batch_it = num_wildcards == 3 ? permutation.select_all()
+                                               : permutation.select(query);
+            uint64_t size = batch_sizes[batches++ % 3];
+            uint64_t i = 0;
+            while (uint64_t k = batch_it.next_batch(batch.data(), size)) {
+                for (uint64_t j = 0; j != k; ++j, ++i) {
+                    if (i == triplets.size()) {
+                        std::cout << "Error: next_batch returned too many "
+                                     "triples"
+                                  << std::endl;
+                        return;
+                    }
+                    if (!util::check(begin + i, params.num_triplets, batch[j],
+                                     triplets[i])) {
+                        return;
+                    }
+                }
+            }
+            if (!util::check(begin, params.num_triplets, i,
+                             uint64_t(triplets.size()))) {
+                return;
+            }
             if (n == params.num_triplets) break;
         }
     }
@@ -101,7 +156,6 @@ void check(parameters const& params, Permutation& permutation,
     util::logger("checked " + std::to_string(n) + "/" +
                  std::to_string(params.num_triplets) + " triplets");
     util::logger("OK");
-    input.close();
 }
 
 template <typename Permutation>
@@ -112,11 +166,8 @@ void check(parameters const& params, Permutation& permutation, int perm,
     check(params, permutation, filename.c_str(), perm, num_wildcards);
 }
 
-template <typename Index>
-void check(parameters const& params, char const* index_filename) {
-    Index index;
-    essentials::load(index, index_filename);
-
+template <typename SPO, typename POS, typename OSP>
+void check(parameters const& params, index_3t<SPO, POS, OSP>& index) {
     for (int num_wildcards = 3; num_wildcards >= 0; --num_wildcards) {
         std::cout << std::endl;
         util::logger("checking queries with " + std::to_string(num_wildcards) +
@@ -133,11 +184,8 @@ void check(parameters const& params, char const* index_filename) {
     }
 }
 
-// specialization
-void check_2to(parameters const& params, char const* index_filename) {
-    pef_2to index;
-    essentials::load(index, index_filename);
-
+template <typename SPO, typename OPS>
+void check(parameters const& params, index_2to<SPO, OPS>& index) {
     for (int num_wildcards = 3; num_wildcards >= 0; --num_wildcards) {
         std::cout << std::endl;
         util::logger("checking queries with " + std::to_string(num_wildcards) +
@@ -163,11 +211,8 @@ void check_2to(parameters const& params, char const* index_filename) {
     check(params, index, filename.c_str(), perm, 2);
 }
 
-// specialization
-void check_2tp(parameters const& params, char const* index_filename) {
-    pef_2tp index;
-    essentials::load(index, index_filename);
-
+template <typename SPO, typename POS>
+void check(parameters const& params, index_2tp<SPO, POS>& index) {
     for (int num_wildcards = 3; num_wildcards >= 0; --num_wildcards) {
         std::cout << std::endl;
         util::logger("checking queries with " + std::to_string(num_wildcards) +
@@ -193,43 +238,31 @@ void check_2tp(parameters const& params, char const* index_filename) {
     check(params, index, filename.c_str(), perm, 2);
 }
 
+template <typename Index>
+void check(parameters const& params, char const* index_filename) {
+    Index index;
+    load_index(index, index_filename);
+    check(params, index);
+}
+
 int main(int argc, char** argv) {
-    int mandatory = 4;
+    int mandatory = 3;
     if (argc < mandatory) {
-        std::cout << argv[0] << " <type> <collection_basename> <index_filename>"
+        std::cout << argv[0] << " <collection_basename> <index_filename>"
                   << std::endl;
         return 1;
     }
 
-    std::string type(argv[1]);
     parameters params;
-    params.collection_basename = argv[2];
+    params.collection_basename = argv[1];
     params.load();
-    char const* index_filename = argv[3];
+    char const* index_filename = argv[2];
 
-    if (type == "pef_2to") {
-        check_2to(params, index_filename);
-        return 0;
-    }
-
-    if (type == "pef_2tp") {
-        check_2tp(params, index_filename);
-        return 0;
-    }
-
-    if (type == "compact_3t") {
-        check<compact_3t>(params, index_filename);
-    } else if (type == "ef_3t") {
-        check<ef_3t>(params, index_filename);
-    } else if (type == "pef_3t") {
-        check<pef_3t>(params, index_filename);
-    } else if (type == "vb_3t") {
-        check<vb_3t>(params, index_filename);
-    } else if (type == "pef_r_3t") {
-        check<pef_r_3t>(params, index_filename);
-    } else {
-        building_util::unknown_type(type);
-    }
+    std::string type = index_type(index_filename);
+    bool known = dispatch(type, [&](auto tag) {
+        check<typename decltype(tag)::type>(params, index_filename);
+    });
+    if (!known) building_util::unknown_type(type);
 
     return 0;
 }